@@ -9,15 +9,22 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    botworker.cpp \
+    frameprofiler.cpp \
     main.cpp \
     mainwindow.cpp
 
 HEADERS += \
+    botworker.h \
+    frameprofiler.h \
     mainwindow.h
 
 FORMS += \
     mainwindow.ui
 
+include(TetrisEngine/TetrisEngine.pri)
+include(TetrisProtocol/TetrisProtocol.pri)
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
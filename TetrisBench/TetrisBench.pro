@@ -0,0 +1,13 @@
+# 引擎熱點的微基準 (碰撞、放置、消行、垃圾行、序列化)，結果輸出 JSON 方便比對
+# 只用 QtCore：拿來量舊版 JSON 狀態封包的成本
+QT -= gui
+QT += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+SOURCES += \
+        main.cpp
+
+include(../TetrisEngine/TetrisEngine.pri)
+include(../TetrisProtocol/TetrisProtocol.pri)
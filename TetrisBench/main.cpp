@@ -0,0 +1,424 @@
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "piecetables.h"
+#include "protocol.h"
+#include "tetrisbot.h"
+#include "tetrisengine.h"
+
+// 用法：TetrisBench [--filter TEXT] [--min-time MS] [--format json|csv] [--out FILE] [--compare BASELINE.json] [--threshold PERCENT]
+// 引擎熱點的微基準：每一項先估計要跑幾次，再量好幾輪取中位數 (ns/op)。
+// 輸出 JSON 給 CI 存檔；--compare 拿舊的結果比對，變慢超過門檻就回傳 1。
+static void printUsage()
+{
+    std::printf("Usage: TetrisBench [options]\n"
+                "  --filter TEXT         only run benchmarks whose name contains TEXT\n"
+                "  --min-time MS         time spent per sample (default 100)\n"
+                "  --format json|csv     output format (default json)\n"
+                "  --out FILE            write results to FILE instead of stdout\n"
+                "  --compare FILE        compare with an earlier JSON result\n"
+                "  --threshold PERCENT   slowdown that counts as a regression (default 10)\n");
+}
+
+static const int SAMPLES = 5;
+
+// 結果累加到這裡，避免編譯器把要量的東西整個優化掉
+static volatile uint64_t sink;
+
+struct Benchmark
+{
+    const char *name;
+    int bytes;                              // 序列化結果的大小 (其他項目為 0)
+    std::function<void(long)> run;          // 跑 n 次
+};
+
+struct BenchResult
+{
+    QString name;
+    long iterations;
+    double nsPerOp;        // 各輪的中位數
+    double minNsPerOp;
+    int bytes;
+};
+
+// --- 測試用的盤面 ---
+
+// 中盤的樣子：下面 8 列各有 1~2 個洞，上面空的
+static TetrisBoard midgameBoard()
+{
+    TetrisBoard board;
+    board.clear();
+    Pcg32 rng;
+    rng.seed(12345, 1);
+    for (int y = GAME_ROWS - 8; y < GAME_ROWS; ++y) {
+        for (int x = 0; x < GAME_COLS; ++x) board.setCell(x, y, 1 + int(rng.bounded(7)));
+        board.setCell(int(rng.bounded(GAME_COLS)), y, 0);
+        if (rng.bounded(2)) board.setCell(int(rng.bounded(GAME_COLS)), y, 0);
+    }
+    return board;
+}
+
+// 最左欄放直的 I 剛好消掉最下面 lines 列 (其他列多留一個洞不會消)
+static TetrisBoard clearBoard(int lines)
+{
+    TetrisBoard board;
+    board.clear();
+    for (int y = GAME_ROWS - 4; y < GAME_ROWS; ++y) {
+        for (int x = 1; x < GAME_COLS; ++x) board.setCell(x, y, GARBAGE_COLOR);
+        if (y < GAME_ROWS - lines) board.setCell(1, y, 0);
+    }
+    return board;
+}
+
+static Protocol::GameState sampleGameState(const TetrisEngine &engine)
+{
+    Protocol::GameState state;
+    state.board = engine.board();
+    state.hold = 3;
+    state.nextCount = NEXT_QUEUE_SIZE;
+    for (int i = 0; i < state.nextCount; ++i) state.next[i] = engine.nextPiece(i);
+    return state;
+}
+
+// 跟 MainWindow::sendGameState 的舊版 JSON 一樣的格式
+static QByteArray gameStateJson(const Protocol::GameState &state)
+{
+    QJsonObject root;
+    root["type"] = "game_state";
+    QJsonArray boardArr;
+    for (int y = 0; y < GAME_ROWS; y++) {
+        for (int x = 0; x < GAME_COLS; x++) boardArr.append(state.board.cell(x, y));
+    }
+    root["board"] = boardArr;
+    root["hold"] = state.hold;
+    QJsonArray nextArr;
+    for (int i = 0; i < state.nextCount; i++) nextArr.append(state.next[i]);
+    root["next_queue"] = nextArr;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n";
+}
+
+static void parseGameStateJson(const QByteArray &line, Protocol::GameState &state)
+{
+    QJsonObject root = QJsonDocument::fromJson(line).object();
+    QJsonArray boardArr = root["board"].toArray();
+    state.board.clear();
+    for (int i = 0; i < boardArr.size() && i < GAME_ROWS * GAME_COLS; ++i) {
+        state.board.setCell(i % GAME_COLS, i / GAME_COLS, boardArr[i].toInt());
+    }
+    state.hold = root["hold"].toInt();
+    QJsonArray nextArr = root["next_queue"].toArray();
+    state.nextCount = std::min(int(nextArr.size()), NEXT_QUEUE_SIZE);
+    for (int i = 0; i < state.nextCount; ++i) state.next[i] = nextArr[i].toInt();
+}
+
+static std::vector<Benchmark> buildBenchmarks()
+{
+    std::vector<Benchmark> list;
+
+    // 碰撞：目前的方塊在各種位置/旋轉試移動
+    list.push_back({"try_move", 0, [](long n) {
+        TetrisEngine engine;
+        engine.reset(1);
+        engine.correct(midgameBoard(), TetrisPiece{6, 0, 4, 0}, 0, true);
+        uint64_t hits = 0;
+        for (long i = 0; i < n; ++i) {
+            int x = int(i % 12) - 1;
+            int y = int((i / 12) % GAME_ROWS);
+            hits += engine.tryMove(x, y, int(i & 3));
+        }
+        sink += hits;
+    }});
+
+    list.push_back({"ghost_y", 0, [](long n) {
+        TetrisEngine engine;
+        engine.reset(1);
+        TetrisBoard board = midgameBoard();
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) {
+            engine.correct(board, TetrisPiece{1 + int(i % 7), int(i & 3), int(i % 7), 0}, 0, true);
+            total += engine.ghostY();
+        }
+        sink += total;
+    }});
+
+    // 放一顆 (hard drop + 鎖定 + 出下一顆)，不消行；每次從存好的狀態開始
+    list.push_back({"hard_drop", 0, [](long n) {
+        TetrisEngine engine;
+        engine.reset(1);
+        engine.correct(midgameBoard(), TetrisPiece{4, 0, 3, 0}, 0, true);
+        uint8_t state[TetrisEngine::STATE_SIZE];
+        engine.saveState(state);
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) {
+            engine.loadState(state, TetrisEngine::STATE_SIZE);
+            total += engine.hardDrop().placed.y;
+        }
+        sink += total;
+    }});
+
+    // 消 0~4 行 (含 loadState 的成本，跟 clear_lines_0 比就是消行本身)
+    static const char *const CLEAR_NAMES[5] = {"clear_lines_0", "clear_lines_1", "clear_lines_2", "clear_lines_3", "clear_lines_4"};
+    for (int lines = 0; lines <= 4; ++lines) {
+        list.push_back({CLEAR_NAMES[lines], 0, [lines](long n) {
+            TetrisEngine engine;
+            engine.reset(1);
+            engine.correct(clearBoard(lines), TetrisPiece{1, 1, -2, GAME_ROWS - 4}, 0, true);
+            uint8_t state[TetrisEngine::STATE_SIZE];
+            engine.saveState(state);
+            uint64_t total = 0;
+            for (long i = 0; i < n; ++i) {
+                engine.loadState(state, TetrisEngine::STATE_SIZE);
+                total += engine.lockPiece().linesCleared;
+            }
+            sink += total;
+        }});
+    }
+
+    // 一次一行垃圾，疊到一半就清掉重來
+    list.push_back({"add_garbage_line", 0, [](long n) {
+        TetrisEngine engine;
+        engine.reset(1);
+        TetrisBoard empty;
+        empty.clear();
+        TetrisPiece piece = engine.piece();
+        for (long i = 0; i < n; ++i) {
+            if (i % (GAME_ROWS / 2) == 0) engine.correct(empty, piece, 0, true);
+            engine.addGarbageLines(1);
+        }
+        sink += engine.board().rows[GAME_ROWS - 1];
+    }});
+
+    // reset = 設種子 + 洗一袋 + 填滿 NEXT
+    list.push_back({"reset_bag_refill", 0, [](long n) {
+        TetrisEngine engine;
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) {
+            engine.reset(uint32_t(i));
+            total += engine.nextPiece(NEXT_QUEUE_SIZE - 1);
+        }
+        sink += total;
+    }});
+
+    list.push_back({"placement_search", 0, [](long n) {
+        PlacementSearch search;
+        TetrisBoard board = midgameBoard();
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) total += search.run(board, 1 + int(i % 7));
+        sink += total;
+    }});
+
+    // --- 狀態序列化：舊版 JSON vs 二進位 ---
+    TetrisEngine sample;
+    sample.reset(1);
+    sample.correct(midgameBoard(), sample.piece(), 3, false);
+    Protocol::GameState state = sampleGameState(sample);
+
+    uint8_t frame[Protocol::MAX_GAME_STATE_FRAME];
+    int frameSize = Protocol::encodeGameState(state, frame);
+    QByteArray json = gameStateJson(state);
+
+    list.push_back({"state_json_encode", int(json.size()), [state](long n) {
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) total += gameStateJson(state).size();
+        sink += total;
+    }});
+    list.push_back({"state_json_decode", int(json.size()), [json](long n) {
+        Protocol::GameState decoded;
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) {
+            parseGameStateJson(json, decoded);
+            total += decoded.hold;
+        }
+        sink += total;
+    }});
+    list.push_back({"state_binary_encode", frameSize, [state](long n) {
+        uint8_t out[Protocol::MAX_GAME_STATE_FRAME];
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) total += Protocol::encodeGameState(state, out);
+        sink += total + out[Protocol::HEADER_SIZE];
+    }});
+    std::vector<uint8_t> encoded(frame, frame + frameSize);
+    list.push_back({"state_binary_decode", frameSize, [encoded](long n) {
+        Protocol::GameState decoded;
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) {
+            Protocol::decodeGameState(encoded.data() + Protocol::HEADER_SIZE, int(encoded.size()) - Protocol::HEADER_SIZE, decoded);
+            total += decoded.hold;
+        }
+        sink += total;
+    }});
+
+    uint8_t saved[TetrisEngine::STATE_SIZE];
+    sample.saveState(saved);
+    list.push_back({"engine_save_state", TetrisEngine::STATE_SIZE, [sample](long n) {
+        uint8_t out[TetrisEngine::STATE_SIZE];
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) total += sample.saveState(out);
+        sink += total + out[0];
+    }});
+    std::vector<uint8_t> savedState(saved, saved + TetrisEngine::STATE_SIZE);
+    list.push_back({"engine_load_state", TetrisEngine::STATE_SIZE, [savedState](long n) {
+        TetrisEngine engine;
+        uint64_t total = 0;
+        for (long i = 0; i < n; ++i) total += engine.loadState(savedState.data(), TetrisEngine::STATE_SIZE);
+        sink += total;
+    }});
+
+    return list;
+}
+
+static BenchResult measure(const Benchmark &bench, double minTimeMs)
+{
+    using Clock = std::chrono::steady_clock;
+    auto elapsedNs = [&](long n) {
+        Clock::time_point start = Clock::now();
+        bench.run(n);
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    };
+
+    // 次數加倍到一輪至少跑 minTime 的 1/10，再換算成一整輪的次數
+    long n = 1;
+    double ns = elapsedNs(n);
+    while (ns < minTimeMs * 1e5 && n < (1L << 40)) {
+        n *= 2;
+        ns = elapsedNs(n);
+    }
+    n = std::max(1L, long(n * (minTimeMs * 1e6 / std::max(ns, 1.0))));
+
+    std::vector<double> perOp;
+    for (int s = 0; s < SAMPLES; ++s) perOp.push_back(elapsedNs(n) / n);
+    std::sort(perOp.begin(), perOp.end());
+
+    BenchResult result;
+    result.name = QString::fromLatin1(bench.name);
+    result.iterations = n;
+    result.nsPerOp = perOp[SAMPLES / 2];
+    result.minNsPerOp = perOp[0];
+    result.bytes = bench.bytes;
+    return result;
+}
+
+static QJsonDocument resultsJson(const std::vector<BenchResult> &results)
+{
+    QJsonArray list;
+    for (const BenchResult &r : results) {
+        QJsonObject item;
+        item["name"] = r.name;
+        item["iterations"] = double(r.iterations);
+        item["ns_per_op"] = r.nsPerOp;
+        item["min_ns_per_op"] = r.minNsPerOp;
+        item["ops_per_sec"] = r.nsPerOp > 0 ? 1e9 / r.nsPerOp : 0.0;
+        if (r.bytes > 0) item["bytes"] = r.bytes;
+        list.append(item);
+    }
+    QJsonObject root;
+    root["samples"] = SAMPLES;
+    root["benchmarks"] = list;
+    return QJsonDocument(root);
+}
+
+// 跟舊的結果比，回傳變慢超過門檻的項目數
+static int compareWithBaseline(const std::vector<BenchResult> &results, const QString &path, double thresholdPercent)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "%s: cannot open baseline\n", qPrintable(path));
+        return -1;
+    }
+    QJsonArray baseline = QJsonDocument::fromJson(file.readAll()).object()["benchmarks"].toArray();
+
+    int regressions = 0;
+    std::fprintf(stderr, "%-22s %12s %12s %9s\n", "benchmark", "baseline_ns", "current_ns", "change");
+    for (const BenchResult &r : results) {
+        for (const QJsonValue &value : baseline) {
+            QJsonObject old = value.toObject();
+            if (old["name"].toString() != r.name) continue;
+            double before = old["ns_per_op"].toDouble();
+            double change = before > 0 ? (r.nsPerOp - before) * 100.0 / before : 0.0;
+            bool slower = change > thresholdPercent;
+            if (slower) regressions++;
+            std::fprintf(stderr, "%-22s %12.2f %12.2f %+8.1f%%%s\n", qPrintable(r.name), before, r.nsPerOp, change, slower ? "  REGRESSION" : "");
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const char *filter = nullptr;
+    double minTimeMs = 100;
+    bool csv = false;
+    const char *outPath = nullptr;
+    const char *baselinePath = nullptr;
+    double thresholdPercent = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+            printUsage();
+            return 0;
+        }
+        if (!value) {
+            printUsage();
+            return 1;
+        }
+        if (std::strcmp(arg, "--filter") == 0) filter = value;
+        else if (std::strcmp(arg, "--min-time") == 0) minTimeMs = std::max(1.0, std::strtod(value, nullptr));
+        else if (std::strcmp(arg, "--format") == 0) csv = std::strcmp(value, "csv") == 0;
+        else if (std::strcmp(arg, "--out") == 0) outPath = value;
+        else if (std::strcmp(arg, "--compare") == 0) baselinePath = value;
+        else if (std::strcmp(arg, "--threshold") == 0) thresholdPercent = std::strtod(value, nullptr);
+        else {
+            printUsage();
+            return 1;
+        }
+        i++;
+    }
+
+    std::vector<BenchResult> results;
+    for (const Benchmark &bench : buildBenchmarks()) {
+        if (filter && !std::strstr(bench.name, filter)) continue;
+        results.push_back(measure(bench, minTimeMs));
+        std::fprintf(stderr, "%-22s %10.2f ns/op\n", bench.name, results.back().nsPerOp);
+    }
+
+    QByteArray output;
+    if (csv) {
+        output = "name,iterations,ns_per_op,min_ns_per_op,bytes\n";
+        for (const BenchResult &r : results) {
+            output += QString("%1,%2,%3,%4,%5\n").arg(r.name).arg(r.iterations)
+                      .arg(r.nsPerOp, 0, 'f', 3).arg(r.minNsPerOp, 0, 'f', 3).arg(r.bytes).toUtf8();
+        }
+    } else {
+        output = resultsJson(results).toJson(QJsonDocument::Indented);
+    }
+
+    if (outPath) {
+        QFile file(QString::fromLocal8Bit(outPath));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "%s: cannot open for writing\n", outPath);
+            return 1;
+        }
+        file.write(output);
+    } else {
+        std::fwrite(output.constData(), 1, size_t(output.size()), stdout);
+    }
+
+    if (baselinePath) {
+        int regressions = compareWithBaseline(results, QString::fromLocal8Bit(baselinePath), thresholdPercent);
+        if (regressions != 0) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+# 遊戲規則核心 (純 C++，不依賴 Qt)，Client 與 Server 都 include 這個檔案
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+CONFIG += thread    # beam search 的 work-stealing pool 用 std::thread
+
+SOURCES += \
+    $$PWD/beamsearch.cpp \
+    $$PWD/replay.cpp \
+    $$PWD/taskpool.cpp \
+    $$PWD/tetrisbot.cpp \
+    $$PWD/tetrisengine.cpp \
+    $$PWD/ticker.cpp
+
+HEADERS += \
+    $$PWD/beamsearch.h \
+    $$PWD/pcg32.h \
+    $$PWD/piecetables.h \
+    $$PWD/replay.h \
+    $$PWD/taskpool.h \
+    $$PWD/tetrisbot.h \
+    $$PWD/tetrisengine.h \
+    $$PWD/ticker.h
@@ -0,0 +1,7 @@
+TEMPLATE = lib
+TARGET = TetrisEngine
+
+CONFIG += staticlib c++17
+CONFIG -= qt
+
+include(TetrisEngine.pri)
@@ -0,0 +1,213 @@
+#include "beamsearch.h"
+#include <algorithm>
+#include <chrono>
+
+// --- TranspositionTable ---
+
+void BeamSearchBot::TranspositionTable::reset(size_t minCapacity)
+{
+    size_t capacity = 64;
+    while (capacity < minCapacity * 2) capacity <<= 1;
+    keys.assign(capacity, 0);
+    indices.assign(capacity, -1);
+    mask = capacity - 1;
+}
+
+int BeamSearchBot::TranspositionTable::findOrInsert(uint64_t key, int index)
+{
+    if (key == 0) key = 1; // 0 代表空格
+    for (size_t slot = key & mask;; slot = (slot + 1) & mask) {
+        if (keys[slot] == key) return indices[slot];
+        if (keys[slot] == 0) {
+            keys[slot] = key;
+            indices[slot] = index;
+            return -1;
+        }
+    }
+}
+
+// --- BeamSearchBot ---
+
+BeamSearchBot::BeamSearchBot(const BotWeights &weights, int threadCount)
+    : evaluator(weights), searching(nullptr), pool(threadCount), depthReached(0), nodesExpanded(0)
+{
+}
+
+uint64_t BeamSearchBot::hashNode(const Node &node)
+{
+    // FNV-1a 再做一次 splitmix 混合，顏色不影響局面所以只看遮罩
+    uint64_t h = 1469598103934665603ULL;
+    for (int y = 0; y < GAME_ROWS; ++y) {
+        h = (h ^ node.board.rows[y]) * 1099511628211ULL;
+    }
+    h = (h ^ uint64_t(node.hold)) * 1099511628211ULL;
+    h = (h ^ uint64_t(node.seqPos)) * 1099511628211ULL;
+    h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+void BeamSearchBot::addChild(const Node &parent, const TetrisBoard &board, const TetrisPiece &placed, int hold, int seqPos, std::vector<Node> &out) const
+{
+    Node child;
+    child.board = board;
+    int lines = TetrisBot::placeOnBoard(child.board, placed);
+
+    // 下一顆出生位置被擋住 = 輸了，這條路不要
+    if (seqPos < SEQUENCE_SIZE && !pieceFits(child.board, sequence[seqPos], 0, GAME_COLS / 2 - 1, 0)) return;
+
+    const BotWeights &w = evaluator.weights();
+    child.reward = parent.reward + w.lines * lines + w.attack * searching->attackForLines(lines);
+    child.score = child.reward + evaluator.evaluate(child.board, 0, 0);
+    child.hold = hold;
+    child.seqPos = seqPos;
+    child.root = parent.root;
+    out.push_back(child);
+}
+
+void BeamSearchBot::expand(const Node &node, std::vector<Node> &out) const
+{
+    if (node.seqPos >= SEQUENCE_SIZE) return;
+    static thread_local PlacementSearch finder;
+
+    int current = sequence[node.seqPos];
+    int found = finder.run(node.board, current);
+    for (int i = 0; i < found; ++i) addChild(node, node.board, finder.landing(i), node.hold, node.seqPos + 1, out);
+
+    // HOLD：沒有 HOLD 就放下一顆，有的話跟 HOLD 交換
+    int swapped = node.hold != 0 ? node.hold : (node.seqPos + 1 < SEQUENCE_SIZE ? sequence[node.seqPos + 1] : 0);
+    if (swapped == 0 || swapped == current) return;
+    int nextPos = node.hold != 0 ? node.seqPos + 1 : node.seqPos + 2;
+    found = finder.run(node.board, swapped);
+    for (int i = 0; i < found; ++i) addChild(node, node.board, finder.landing(i), current, nextPos, out);
+}
+
+void BeamSearchBot::selectBeam(std::vector<std::vector<Node>> &children, int beamWidth, std::vector<Node> &beam)
+{
+    size_t total = 0;
+    for (const std::vector<Node> &list : children) total += list.size();
+
+    beam.clear();
+    beam.reserve(total);
+    table.reset(total);
+    for (const std::vector<Node> &list : children) {
+        for (const Node &child : list) {
+            int existing = table.findOrInsert(hashNode(child), static_cast<int>(beam.size()));
+            if (existing < 0) beam.push_back(child);
+            else if (child.score > beam[existing].score) beam[existing] = child;
+        }
+    }
+    nodesExpanded += static_cast<int>(total);
+
+    auto better = [](const Node &a, const Node &b) { return a.score > b.score; };
+    if (static_cast<int>(beam.size()) > beamWidth) {
+        std::nth_element(beam.begin(), beam.begin() + beamWidth, beam.end(), better);
+        beam.resize(beamWidth);
+    }
+}
+
+BotPlan BeamSearchBot::search(const TetrisEngine &engine, const BeamSettings &settings)
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(settings.timeBudgetMs);
+    bool timed = settings.timeBudgetMs > 0;
+    depthReached = 0;
+    nodesExpanded = 0;
+    searching = &engine;
+
+    if (settings.depth <= 1 || settings.beamWidth <= 0) {
+        depthReached = 1;
+        return evaluator.plan(engine);
+    }
+
+    BotPlan none;
+    none.found = false;
+    none.useHold = false;
+    none.score = 0;
+    none.inputCount = 0;
+    if (engine.isGameOver()) return none;
+
+    sequence[0] = engine.piece().shape;
+    for (int i = 0; i < NEXT_QUEUE_SIZE; ++i) sequence[1 + i] = engine.nextPiece(i);
+
+    // 第一層：從方塊目前的位置開始找，順便記下每個落點的走法
+    std::vector<BotPlan> rootPlans;
+    std::vector<std::vector<Node>> children(1);
+    static thread_local PlacementSearch finder;
+
+    Node root;
+    root.board = engine.board();
+    root.reward = 0;
+    root.score = 0;
+    root.hold = engine.heldShape();
+    root.seqPos = 0;
+    root.root = -1;
+
+    for (int option = 0; option < 2; ++option) {
+        int placedShape = sequence[0];
+        int hold = root.hold;
+        int seqPos = 1;
+        if (option == 1) {
+            if (!engine.canHold()) break;
+            placedShape = root.hold != 0 ? root.hold : sequence[1];
+            if (placedShape == sequence[0]) break;
+            hold = sequence[0];
+            seqPos = root.hold != 0 ? 1 : 2;
+        }
+
+        int found = option == 0 ? finder.run(root.board, engine.piece()) : finder.run(root.board, placedShape);
+        for (int i = 0; i < found; ++i) {
+            BotPlan plan;
+            plan.found = true;
+            plan.useHold = option == 1;
+            plan.target = finder.landing(i);
+            plan.score = 0;
+            plan.inputCount = 0;
+            if (plan.useHold) plan.inputs[plan.inputCount++] = INPUT_HOLD;
+            plan.inputCount += finder.path(i, plan.inputs + plan.inputCount, BOT_MAX_PATH - plan.inputCount);
+
+            size_t before = children[0].size();
+            root.root = static_cast<int>(rootPlans.size());
+            addChild(root, root.board, plan.target, hold, seqPos, children[0]);
+            if (children[0].size() != before) rootPlans.push_back(plan);
+        }
+    }
+    if (rootPlans.empty()) return evaluator.plan(engine); // 怎麼放都會輸，至少照一層的方式放
+
+    std::vector<Node> beam;
+    std::vector<Node> next;
+    selectBeam(children, settings.beamWidth, beam);
+    depthReached = 1;
+
+    // 之後每一層平行展開，時間到了就停在上一層完整的結果
+    for (int depth = 2; depth <= settings.depth; ++depth) {
+        if (timed && Clock::now() >= deadline) break;
+
+        children.resize(beam.size());
+        for (std::vector<Node> &list : children) list.clear();
+        std::atomic<bool> timedOut(false);
+        pool.parallelFor(static_cast<int>(beam.size()), [&](int i) {
+            if (timedOut.load(std::memory_order_relaxed)) return;
+            if (timed && Clock::now() >= deadline) {
+                timedOut.store(true, std::memory_order_relaxed);
+                return;
+            }
+            expand(beam[i], children[i]);
+        });
+        if (timedOut.load()) break;
+
+        selectBeam(children, settings.beamWidth, next);
+        if (next.empty()) break;
+        beam.swap(next);
+        depthReached = depth;
+    }
+
+    const Node *best = &beam[0];
+    for (const Node &node : beam) {
+        if (node.score > best->score) best = &node;
+    }
+    BotPlan plan = rootPlans[best->root];
+    plan.score = best->score;
+    return plan;
+}
@@ -0,0 +1,71 @@
+#ifndef BEAMSEARCH_H
+#define BEAMSEARCH_H
+
+#include <cstdint>
+#include <vector>
+#include "tetrisbot.h"
+#include "taskpool.h"
+
+// 進階電腦：往後看好幾顆 (目前 + NEXT 5 顆 + HOLD) 的 beam search。
+// 每一層只留分數最高的 beamWidth 個盤面，同一個盤面 (不同放法走到一樣的結果) 用
+// transposition table 合併；每個節點的展開丟給 work-stealing pool 平行做。
+// 時間到了就用目前為止最深一層的最好結果，不會卡住呼叫端。
+
+struct BeamSettings
+{
+    int beamWidth;
+    int depth;          // 最多看幾顆方塊 (1 = 跟 TetrisBot 一樣只看目前這顆)
+    int timeBudgetMs;   // <= 0 表示不限時，一定搜到 depth 層 (結果只跟盤面有關)
+};
+
+class BeamSearchBot
+{
+public:
+    explicit BeamSearchBot(const BotWeights &weights = DEFAULT_BOT_WEIGHTS, int threadCount = 0);
+
+    BotPlan search(const TetrisEngine &engine, const BeamSettings &settings);
+
+    // 上一次搜尋的統計 (除錯用)
+    int lastDepth() const { return depthReached; }
+    int lastNodes() const { return nodesExpanded; }
+
+private:
+    static const int SEQUENCE_SIZE = 1 + NEXT_QUEUE_SIZE;
+
+    struct Node {
+        TetrisBoard board;
+        double reward;      // 一路上消行 / 攻擊累積的分數
+        double score;       // reward + 盤面評分
+        int hold;
+        int seqPos;         // 下一顆要放的是 sequence[seqPos]
+        int root;           // 來自第幾個第一步
+    };
+
+    // 以盤面 + HOLD + 進度為 key，同一個局面只留分數最高的
+    class TranspositionTable
+    {
+    public:
+        void reset(size_t minCapacity);
+        // 回傳 -1 表示新局面 (呼叫端要插入)，否則回傳已經存在的 index
+        int findOrInsert(uint64_t key, int index);
+    private:
+        std::vector<uint64_t> keys;
+        std::vector<int> indices;
+        size_t mask = 0;
+    };
+
+    static uint64_t hashNode(const Node &node);
+    void expand(const Node &node, std::vector<Node> &out) const;
+    void addChild(const Node &parent, const TetrisBoard &board, const TetrisPiece &placed, int hold, int seqPos, std::vector<Node> &out) const;
+    void selectBeam(std::vector<std::vector<Node>> &children, int beamWidth, std::vector<Node> &beam);
+
+    TetrisBot evaluator;
+    const TetrisEngine *searching; // 搜尋中的對局 (只在 search 裡有效)，攻擊照它的規則算
+    WorkStealingPool pool;
+    TranspositionTable table;
+    int sequence[SEQUENCE_SIZE];
+    int depthReached;
+    int nodesExpanded;
+};
+
+#endif // BEAMSEARCH_H
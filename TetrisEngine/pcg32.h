@@ -0,0 +1,43 @@
+#ifndef PCG32_H
+#define PCG32_H
+
+#include <cstdint>
+
+// PCG32 (O'Neill, pcg-random.org 的最小版本)：64-bit 狀態、固定的整數運算，
+// 不同平台、編譯器、標準函式庫產生的序列都一樣，用來重現整場對戰。
+struct Pcg32
+{
+    uint64_t state = 0;
+    uint64_t inc = 1;
+
+    // stream 不同的兩個產生器即使種子一樣，序列也互不相關
+    void seed(uint64_t initState, uint64_t stream)
+    {
+        state = 0;
+        inc = (stream << 1u) | 1u;
+        next();
+        state += initState;
+        next();
+    }
+
+    uint32_t next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = static_cast<uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+    }
+
+    // [0, bound) 且沒有取餘數造成的偏差
+    uint32_t bounded(uint32_t bound)
+    {
+        uint32_t threshold = (0u - bound) % bound;
+        for (;;) {
+            uint32_t r = next();
+            if (r >= threshold) return r % bound;
+        }
+    }
+};
+
+#endif // PCG32_H
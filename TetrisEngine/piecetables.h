@@ -0,0 +1,71 @@
+#ifndef PIECETABLES_H
+#define PIECETABLES_H
+
+#include <cstdint>
+
+// 每種方塊 (shape 1~7) 四個旋轉方向的格子座標，shape 0 為空
+// [shape][rotation][cell][x/y]
+constexpr int SHAPE_CELLS[8][4][4][2] = {
+    { { {0,0}, {0,0}, {0,0}, {0,0} }, { {0,0}, {0,0}, {0,0}, {0,0} }, { {0,0}, {0,0}, {0,0}, {0,0} }, { {0,0}, {0,0}, {0,0}, {0,0} } },
+    { { {0,1}, {1,1}, {2,1}, {3,1} }, { {2,0}, {2,1}, {2,2}, {2,3} }, { {0,2}, {1,2}, {2,2}, {3,2} }, { {1,0}, {1,1}, {1,2}, {1,3} } },
+    { { {0,0}, {0,1}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {1,2} }, { {0,1}, {1,1}, {2,1}, {2,2} }, { {1,0}, {1,1}, {0,2}, {1,2} } },
+    { { {2,0}, {0,1}, {1,1}, {2,1} }, { {1,0}, {1,1}, {1,2}, {2,2} }, { {0,1}, {1,1}, {2,1}, {0,2} }, { {0,0}, {1,0}, {1,1}, {1,2} } },
+    { { {1,0}, {2,0}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {2,1} } },
+    { { {1,0}, {2,0}, {0,1}, {1,1} }, { {1,0}, {1,1}, {2,1}, {2,2} }, { {1,1}, {2,1}, {0,2}, {1,2} }, { {0,0}, {0,1}, {1,1}, {1,2} } },
+    { { {1,0}, {0,1}, {1,1}, {2,1} }, { {1,0}, {1,1}, {2,1}, {1,2} }, { {0,1}, {1,1}, {2,1}, {1,2} }, { {1,0}, {0,1}, {1,1}, {1,2} } },
+    { { {0,0}, {1,0}, {1,1}, {2,1} }, { {2,0}, {1,1}, {2,1}, {1,2} }, { {0,1}, {1,1}, {1,2}, {2,2} }, { {1,0}, {0,1}, {1,1}, {0,2} } }
+};
+
+// 編譯期算好的碰撞資料：
+// rows[r] 是 4x4 方框第 r 列的遮罩，已經右移 minX，所以放到盤面時只要左移 (x + minX)
+struct PieceMask
+{
+    uint16_t rows[4];
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+};
+
+struct PieceMaskTable
+{
+    PieceMask masks[8][4];
+};
+
+constexpr PieceMaskTable buildPieceMasks()
+{
+    PieceMaskTable table = {};
+    for (int shape = 1; shape < 8; ++shape) {
+        for (int rot = 0; rot < 4; ++rot) {
+            PieceMask m = {};
+            m.minX = 4; m.maxX = -1; m.minY = 4; m.maxY = -1;
+            for (int i = 0; i < 4; ++i) {
+                int x = SHAPE_CELLS[shape][rot][i][0];
+                int y = SHAPE_CELLS[shape][rot][i][1];
+                if (x < m.minX) m.minX = x;
+                if (x > m.maxX) m.maxX = x;
+                if (y < m.minY) m.minY = y;
+                if (y > m.maxY) m.maxY = y;
+            }
+            for (int i = 0; i < 4; ++i) {
+                int x = SHAPE_CELLS[shape][rot][i][0];
+                int y = SHAPE_CELLS[shape][rot][i][1];
+                m.rows[y] = static_cast<uint16_t>(m.rows[y] | (1u << (x - m.minX)));
+            }
+            table.masks[shape][rot] = m;
+        }
+    }
+    return table;
+}
+
+constexpr PieceMaskTable PIECE_MASKS = buildPieceMasks();
+
+static_assert(PIECE_MASKS.masks[1][0].rows[1] == 0xF, "I piece mask");
+static_assert(PIECE_MASKS.masks[4][0].minX == 1 && PIECE_MASKS.masks[4][0].rows[0] == 0x3, "O piece mask");
+
+inline const PieceMask &pieceMask(int shape, int rotation)
+{
+    return PIECE_MASKS.masks[shape][rotation];
+}
+
+#endif // PIECETABLES_H
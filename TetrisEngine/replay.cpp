@@ -0,0 +1,293 @@
+#include "replay.h"
+#include <cstring>
+
+namespace Replay {
+
+static uint8_t *writeVarint(uint8_t *p, uint32_t value)
+{
+    while (value >= 0x80) {
+        *p++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(value);
+    return p;
+}
+
+static bool readVarint(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p >= end) return false;
+        uint8_t byte = *p++;
+        value |= uint32_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// --- Writer ---
+
+Writer::Writer()
+    : file(nullptr), lastFrame(0), inputsSinceSnapshot(0), buffered(0)
+{
+}
+
+Writer::~Writer()
+{
+    close();
+}
+
+bool Writer::open(const char *path, uint32_t seed)
+{
+    close();
+    file = std::fopen(path, "wb");
+    if (!file) return false;
+
+    lastFrame = 0;
+    inputsSinceSnapshot = 0;
+    uint8_t header[HEADER_SIZE];
+    std::memcpy(header, FILE_MAGIC, 4);
+    header[4] = FILE_VERSION;
+    for (int i = 0; i < 4; ++i) header[5 + i] = static_cast<uint8_t>(seed >> (i * 8));
+    append(header, HEADER_SIZE);
+    return true;
+}
+
+void Writer::close()
+{
+    if (!file) return;
+    flush();
+    std::fclose(file);
+    file = nullptr;
+}
+
+uint8_t *Writer::beginRecord(uint8_t *p, RecordType type, uint32_t frame, int inputBits)
+{
+    if (frame < lastFrame) frame = lastFrame; // 時間不會倒退
+    *p++ = static_cast<uint8_t>(type | (inputBits << 4));
+    p = writeVarint(p, frame - lastFrame);
+    lastFrame = frame;
+    return p;
+}
+
+void Writer::recordInput(uint32_t frame, TetrisInput input, const TetrisEngine &engine)
+{
+    if (!file) return;
+    if (inputsSinceSnapshot >= SNAPSHOT_INTERVAL) recordSnapshot(frame, engine);
+
+    uint8_t record[8];
+    uint8_t *p = beginRecord(record, REC_INPUT, frame, input);
+    append(record, static_cast<int>(p - record));
+    inputsSinceSnapshot++;
+}
+
+void Writer::recordGarbage(uint32_t frame, int count, const int *holes)
+{
+    if (!file || count <= 0) return;
+    if (count >= GAME_ROWS) count = GAME_ROWS - 1;
+
+    uint8_t record[8 + GAME_ROWS];
+    uint8_t *p = beginRecord(record, REC_GARBAGE, frame);
+    *p++ = static_cast<uint8_t>(count);
+    for (int i = 0; i < count; ++i) *p++ = static_cast<uint8_t>(holes[i]);
+    append(record, static_cast<int>(p - record));
+}
+
+void Writer::recordSnapshot(uint32_t frame, const TetrisEngine &engine)
+{
+    if (!file) return;
+    uint8_t record[8 + TetrisEngine::STATE_SIZE];
+    uint8_t *p = beginRecord(record, REC_SNAPSHOT, frame);
+    p += engine.saveState(p);
+    append(record, static_cast<int>(p - record));
+    inputsSinceSnapshot = 0;
+    flush(); // 快照是安全的回復點，順便寫進檔案
+}
+
+void Writer::recordEnd(uint32_t frame)
+{
+    if (!file) return;
+    uint8_t record[8];
+    uint8_t *p = beginRecord(record, REC_END, frame);
+    append(record, static_cast<int>(p - record));
+    flush();
+}
+
+void Writer::append(const uint8_t *bytes, int size)
+{
+    if (buffered + size > int(sizeof(buffer))) flush();
+    std::memcpy(buffer + buffered, bytes, size);
+    buffered += size;
+}
+
+void Writer::flush()
+{
+    if (buffered > 0 && file) std::fwrite(buffer, 1, buffered, file);
+    buffered = 0;
+    if (file) std::fflush(file);
+}
+
+// --- Player ---
+
+Player::Player()
+    : matchSeed(0), cursor(0), validEnd(0), currentFrame(0), endFrame(0), inputs(0)
+{
+}
+
+bool Player::load(const char *path)
+{
+    std::FILE *f = std::fopen(path, "rb");
+    if (!f) return false;
+
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[8192];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) bytes.insert(bytes.end(), chunk, chunk + n);
+    std::fclose(f);
+    return loadFromMemory(bytes.data(), bytes.size());
+}
+
+bool Player::loadFromMemory(const uint8_t *bytes, size_t size)
+{
+    if (size < size_t(HEADER_SIZE) || std::memcmp(bytes, FILE_MAGIC, 4) != 0 || bytes[4] != FILE_VERSION) return false;
+
+    data.assign(bytes, bytes + size);
+    matchSeed = 0;
+    for (int i = 0; i < 4; ++i) matchSeed |= uint32_t(data[5 + i]) << (i * 8);
+
+    // 掃一遍建立快照索引，不套用到 engine，所以很便宜
+    snapshots.clear();
+    inputs = 0;
+    size_t pos = HEADER_SIZE;
+    uint32_t frame = 0;
+    for (;;) {
+        size_t start = pos;
+        if (pos < data.size() && (data[pos] & 0x0F) == REC_SNAPSHOT) {
+            uint32_t snapshotFrame = frame;
+            if (!parse(pos, snapshotFrame, false)) break;
+            snapshots.push_back(SnapshotIndex{snapshotFrame, start});
+            frame = snapshotFrame;
+            continue;
+        }
+        if (pos < data.size() && (data[pos] & 0x0F) == REC_INPUT) inputs++;
+        if (!parse(pos, frame, false)) break;
+    }
+    validEnd = pos;
+    endFrame = frame;
+
+    rewind();
+    return true;
+}
+
+bool Player::parse(size_t &pos, uint32_t &frame, bool apply)
+{
+    const uint8_t *p = data.data() + pos;
+    const uint8_t *end = data.data() + data.size();
+    if (p >= end) return false;
+
+    uint8_t tag = *p++;
+    uint32_t delta;
+    if (!readVarint(p, end, delta)) return false;
+    uint32_t recordFrame = frame + delta;
+
+    switch (tag & 0x0F) {
+    case REC_INPUT: {
+        int input = tag >> 4;
+        if (input >= INPUT_COUNT) return false;
+        if (apply) {
+            LockResult result;
+            game.applyInput(static_cast<TetrisInput>(input), result);
+        }
+        break;
+    }
+    case REC_GARBAGE: {
+        if (p >= end) return false;
+        int count = *p++;
+        if (count >= GAME_ROWS || end - p < count) return false;
+        int holes[GAME_ROWS];
+        for (int i = 0; i < count; ++i) holes[i] = p[i];
+        p += count;
+        if (apply) game.addGarbageLines(count, holes);
+        break;
+    }
+    case REC_SNAPSHOT:
+        if (end - p < TetrisEngine::STATE_SIZE) return false;
+        if (apply && !game.loadState(p, TetrisEngine::STATE_SIZE)) return false;
+        p += TetrisEngine::STATE_SIZE;
+        break;
+    case REC_END:
+    default:
+        return false;
+    }
+
+    pos = static_cast<size_t>(p - data.data());
+    frame = recordFrame;
+    return true;
+}
+
+bool Player::step()
+{
+    if (atEnd()) return false;
+    if (!parse(cursor, currentFrame, true)) {
+        cursor = validEnd;
+        return false;
+    }
+    return true;
+}
+
+void Player::seek(uint32_t frame)
+{
+    if (frame < currentFrame) rewind();
+
+    // 找 frame 之前最後一個快照，比目前位置還後面就直接載入
+    for (size_t i = snapshots.size(); i-- > 0;) {
+        const SnapshotIndex &snapshot = snapshots[i];
+        if (snapshot.frame > frame) continue;
+        if (snapshot.offset > cursor) {
+            size_t pos = snapshot.offset;
+            uint32_t snapshotFrame = snapshot.frame;
+            // 快照的 frame 是相對上一筆的，所以從索引裡的絕對 frame 往回算
+            const uint8_t *p = data.data() + pos + 1;
+            uint32_t delta = 0;
+            readVarint(p, data.data() + data.size(), delta);
+            snapshotFrame -= delta;
+            if (parse(pos, snapshotFrame, true)) {
+                cursor = pos;
+                currentFrame = snapshotFrame;
+            }
+        }
+        break;
+    }
+
+    while (!atEnd() && nextFrame() <= frame) {
+        if (!step()) break;
+    }
+}
+
+void Player::runToEnd()
+{
+    while (step()) {}
+}
+
+void Player::rewind()
+{
+    game.reset(matchSeed);
+    cursor = HEADER_SIZE;
+    currentFrame = 0;
+}
+
+bool Player::atEnd() const
+{
+    return cursor >= validEnd;
+}
+
+uint32_t Player::nextFrame() const
+{
+    if (atEnd()) return currentFrame;
+    const uint8_t *p = data.data() + cursor + 1;
+    uint32_t delta = 0;
+    if (!readVarint(p, data.data() + data.size(), delta)) return currentFrame;
+    return currentFrame + delta;
+}
+
+} // namespace Replay
@@ -0,0 +1,106 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "tetrisengine.h"
+
+// 重播檔：種子 + 每個輸入 (含重力與鎖定) + 垃圾行，用 TetrisEngine 重跑就能還原整場。
+//
+// 檔頭：'T' 'R' 'P' 'L' | version | u32 seed
+// 之後是只會往後加的紀錄，每筆以一個 tag 開頭，接著是距離上一筆的 frame 數 (varint，60 fps)：
+//   REC_INPUT     tag 高 4 bits = TetrisInput                          (通常 2 bytes)
+//   REC_GARBAGE   u8 count, holes[count]
+//   REC_SNAPSHOT  TetrisEngine::STATE_SIZE bytes 的完整狀態，快轉用；Server 校正過後也會寫一筆
+//   REC_END       遊戲結束
+// 寫到一半當掉的檔案只會少最後一筆，讀取端讀到不完整的紀錄就當作結尾。
+
+namespace Replay {
+
+const uint8_t FILE_MAGIC[4] = {'T', 'R', 'P', 'L'};
+const int FILE_VERSION = 1;
+const int HEADER_SIZE = 9;
+const int FRAMES_PER_SECOND = 60;
+const int SNAPSHOT_INTERVAL = 256;  // 每幾筆輸入存一次快照
+
+enum RecordType : uint8_t {
+    REC_INPUT = 1,
+    REC_GARBAGE = 2,
+    REC_SNAPSHOT = 3,
+    REC_END = 4
+};
+
+class Writer
+{
+public:
+    Writer();
+    ~Writer();
+
+    bool open(const char *path, uint32_t seed);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    // engine 是套用這個輸入「之前」的狀態，到了快照間隔就先存一份
+    void recordInput(uint32_t frame, TetrisInput input, const TetrisEngine &engine);
+    void recordGarbage(uint32_t frame, int count, const int *holes);
+    void recordSnapshot(uint32_t frame, const TetrisEngine &engine);
+    void recordEnd(uint32_t frame);
+
+private:
+    uint8_t *beginRecord(uint8_t *p, RecordType type, uint32_t frame, int inputBits = 0);
+    void append(const uint8_t *data, int size);
+    void flush();
+
+    std::FILE *file;
+    uint32_t lastFrame;
+    int inputsSinceSnapshot;
+    uint8_t buffer[4096];
+    int buffered;
+};
+
+class Player
+{
+public:
+    Player();
+
+    bool load(const char *path);
+    bool loadFromMemory(const uint8_t *data, size_t size);
+
+    // 往前套用一筆紀錄，已經到結尾回傳 false
+    bool step();
+    // 一路跑到 frame (含) 為止；frame 之前的快照會直接跳過去
+    void seek(uint32_t frame);
+    void runToEnd();
+    void rewind();
+
+    const TetrisEngine &engine() const { return game; }
+    uint32_t frame() const { return currentFrame; }
+    uint32_t nextFrame() const;     // 下一筆紀錄的 frame，已經結尾回傳目前的 frame
+    uint32_t seed() const { return matchSeed; }
+    bool atEnd() const;
+    uint32_t inputCount() const { return inputs; }
+    uint32_t lastFrame() const { return endFrame; }
+
+private:
+    struct SnapshotIndex {
+        uint32_t frame;
+        size_t offset;      // 快照紀錄的 tag 位置
+    };
+
+    bool parse(size_t &pos, uint32_t &frame, bool apply);
+
+    std::vector<uint8_t> data;
+    std::vector<SnapshotIndex> snapshots;
+    TetrisEngine game;
+    uint32_t matchSeed;
+    size_t cursor;
+    size_t validEnd;        // 最後一筆完整紀錄的結尾
+    uint32_t currentFrame;
+    uint32_t endFrame;
+    uint32_t inputs;
+};
+
+} // namespace Replay
+
+#endif // REPLAY_H
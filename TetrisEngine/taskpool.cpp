@@ -0,0 +1,104 @@
+#include "taskpool.h"
+
+WorkStealingPool::WorkStealingPool(int threadCount)
+    : job(nullptr), remaining(0), generation(0), stopping(false)
+{
+    if (threadCount == 0) {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        threadCount = cores > 1 ? cores - 1 : 1;
+    } else if (threadCount < 0) {
+        threadCount = 0;
+    }
+
+    for (int i = 0; i <= threadCount; ++i) queues.emplace_back(new Queue);
+    for (int i = 0; i < threadCount; ++i) threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads) thread.join();
+}
+
+void WorkStealingPool::parallelFor(int count, const std::function<void(int)> &task)
+{
+    if (count <= 0) return;
+
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        job = &task;
+        remaining.store(count);
+
+        // 先切成連續的區段分給每個佇列，相鄰的任務留在同一個執行緒
+        int queueCount = static_cast<int>(queues.size());
+        for (int q = 0; q < queueCount; ++q) {
+            int begin = count * q / queueCount;
+            int end = count * (q + 1) / queueCount;
+            std::lock_guard<std::mutex> queueGuard(queues[q]->lock);
+            for (int i = begin; i < end; ++i) queues[q]->tasks.push_back(i);
+        }
+        generation++;
+    }
+    wake.notify_all();
+
+    int self = static_cast<int>(queues.size()) - 1;
+    while (remaining.load() > 0) {
+        if (runOne(self)) continue;
+        // 佇列都空了，等還在做的人做完
+        std::unique_lock<std::mutex> guard(stateLock);
+        finished.wait(guard, [this] { return remaining.load() == 0; });
+    }
+
+    std::lock_guard<std::mutex> guard(stateLock);
+    job = nullptr;
+}
+
+void WorkStealingPool::workerLoop(int self)
+{
+    unsigned seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(stateLock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        while (runOne(self)) {}
+    }
+}
+
+bool WorkStealingPool::runOne(int self)
+{
+    int task = -1;
+    int queueCount = static_cast<int>(queues.size());
+
+    // 自己的佇列從後面拿，偷別人的從前面拿
+    {
+        Queue &own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+        }
+    }
+    for (int i = 1; task < 0 && i < queueCount; ++i) {
+        Queue &victim = *queues[(self + i) % queueCount];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }
+    }
+    if (task < 0) return false;
+
+    (*job)(task);
+    if (remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> guard(stateLock);
+        finished.notify_all();
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 簡單的 work-stealing 執行緒池：每個 worker 有自己的任務佇列，
+// 自己的做完就去偷別人佇列前面的任務，節點展開時間不平均也不會有人閒著。
+class WorkStealingPool
+{
+public:
+    // threadCount = 0 時用 (CPU 核心數 - 1)，負數表示不開執行緒 (全部由呼叫端做)；
+    // 呼叫 parallelFor 的執行緒自己也會幫忙
+    explicit WorkStealingPool(int threadCount = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int threadCount() const { return static_cast<int>(threads.size()); }
+
+    // 執行 task(0) ~ task(count - 1)，全部做完才回傳；同一時間只能有一個呼叫端
+    void parallelFor(int count, const std::function<void(int)> &task);
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+
+    void workerLoop(int self);
+    bool runOne(int self);
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;   // 最後一個給呼叫端
+
+    std::mutex stateLock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(int)> *job;
+    std::atomic<int> remaining;
+    unsigned generation;
+    bool stopping;
+};
+
+#endif // TASKPOOL_H
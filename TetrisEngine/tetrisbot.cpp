@@ -0,0 +1,199 @@
+#include "tetrisbot.h"
+#include "piecetables.h"
+#include <cstring>
+
+// --- PlacementSearch ---
+
+bool PlacementSearch::visit(int node, int from, Move move, int *queue, int &tail)
+{
+    if (seen[node]) return false;
+    seen[node] = true;
+    parent[node] = static_cast<int16_t>(from);
+    via[node] = move;
+    queue[tail++] = node;
+    return true;
+}
+
+int PlacementSearch::run(const TetrisBoard &searchBoard, int searchShape)
+{
+    // 跟 TetrisEngine::spawnPiece 一樣的出生位置
+    return run(searchBoard, TetrisPiece{searchShape, 0, GAME_COLS / 2 - 1, 0});
+}
+
+int PlacementSearch::run(const TetrisBoard &searchBoard, const TetrisPiece &start)
+{
+    board = &searchBoard;
+    shape = start.shape;
+    landingCount = 0;
+    std::memset(seen, 0, sizeof(seen));
+
+    if (start.y < -GRID_Y_OFFSET || !pieceFits(searchBoard, shape, start.rotation, start.x, start.y)) return 0;
+
+    int queue[GRID_SIZE];
+    int head = 0;
+    int tail = 0;
+    visit(nodeOf(start.rotation, start.x, start.y), -1, MOVE_NONE, queue, tail);
+
+    while (head < tail) {
+        int node = queue[head++];
+        int x = node % GRID_W - GRID_X_OFFSET;
+        int y = nodeY(node);
+        int rot = node / (GRID_W * GRID_H);
+
+        if (pieceFits(searchBoard, shape, rot, x - 1, y)) visit(nodeOf(rot, x - 1, y), node, MOVE_LEFT, queue, tail);
+        if (pieceFits(searchBoard, shape, rot, x + 1, y)) visit(nodeOf(rot, x + 1, y), node, MOVE_RIGHT, queue, tail);
+
+        int nextRot = (rot + 1) % 4;
+        static const int kicks[3] = {0, 1, -1};
+        for (int kick : kicks) {
+            if (pieceFits(searchBoard, shape, nextRot, x + kick, y)) {
+                visit(nodeOf(nextRot, x + kick, y), node, MOVE_ROTATE, queue, tail);
+                break;
+            }
+        }
+
+        int dropY = y;
+        while (pieceFits(searchBoard, shape, rot, x, dropY + 1)) dropY++;
+        if (dropY != y) {
+            visit(nodeOf(rot, x, dropY), node, MOVE_DROP, queue, tail);
+        } else {
+            landings[landingCount] = TetrisPiece{shape, rot, x, y};
+            landingNodes[landingCount] = node;
+            landingCount++;
+        }
+    }
+    return landingCount;
+}
+
+int PlacementSearch::path(int index, TetrisInput *out, int maxInputs) const
+{
+    // 從落點沿 parent 走回出生位置，再反過來展開成 engine 的輸入
+    int chain[GRID_SIZE];
+    int length = 0;
+    for (int node = landingNodes[index]; parent[node] >= 0; node = parent[node]) chain[length++] = node;
+
+    int count = 0;
+    for (int i = length - 1; i >= 0; --i) {
+        int node = chain[i];
+        if (via[node] == MOVE_DROP) {
+            // 落到底 = 一格一格軟降，最後一段直接交給 hard drop
+            if (i == 0) break;
+            int from = parent[node];
+            int fallen = nodeY(node) - nodeY(from);
+            for (int k = 0; k < fallen && count < maxInputs - 1; ++k) out[count++] = INPUT_SOFT_DROP;
+            continue;
+        }
+        if (count >= maxInputs - 1) break;
+        switch (via[node]) {
+        case MOVE_LEFT: out[count++] = INPUT_LEFT; break;
+        case MOVE_RIGHT: out[count++] = INPUT_RIGHT; break;
+        case MOVE_ROTATE: out[count++] = INPUT_ROTATE; break;
+        default: break;
+        }
+    }
+    while (count > 0 && out[count - 1] == INPUT_SOFT_DROP) count--;
+    out[count++] = INPUT_HARD_DROP;
+    return count;
+}
+
+// --- TetrisBot ---
+
+TetrisBot::TetrisBot(const BotWeights &weights)
+    : botWeights(weights)
+{
+}
+
+int TetrisBot::placeOnBoard(TetrisBoard &board, const TetrisPiece &piece)
+{
+    const PieceMask &m = pieceMask(piece.shape, piece.rotation);
+    int left = piece.x + m.minX;
+    for (int r = m.minY; r <= m.maxY; ++r) {
+        int y = piece.y + r;
+        if (y >= 0 && y < GAME_ROWS) board.rows[y] = static_cast<uint16_t>(board.rows[y] | (m.rows[r] << left));
+    }
+
+    uint32_t full = board.fullRows();
+    if (full == 0) return 0;
+    board.removeRows(full);
+    int lines = 0;
+    for (; full; full &= full - 1) lines++;
+    return lines;
+}
+
+double TetrisBot::evaluate(const TetrisBoard &board, int linesCleared, int attack) const
+{
+    int heights[GAME_COLS];
+    int holes = 0;
+    uint16_t covered = 0; // 上方已經有方塊的欄
+    for (int x = 0; x < GAME_COLS; ++x) heights[x] = 0;
+
+    for (int y = 0; y < GAME_ROWS; ++y) {
+        uint16_t row = board.rows[y];
+        uint16_t newTops = row & static_cast<uint16_t>(~covered);
+        for (int x = 0; x < GAME_COLS; ++x) {
+            if ((newTops >> x) & 1u) heights[x] = GAME_ROWS - y;
+        }
+        // 被蓋住的空格就是洞
+        uint16_t holeBits = covered & static_cast<uint16_t>(~row) & FULL_ROW_MASK;
+        for (; holeBits; holeBits &= holeBits - 1) holes++;
+        covered |= row;
+    }
+
+    int aggregate = 0;
+    int bumpiness = 0;
+    for (int x = 0; x < GAME_COLS; ++x) {
+        aggregate += heights[x];
+        if (x > 0) bumpiness += heights[x] > heights[x - 1] ? heights[x] - heights[x - 1] : heights[x - 1] - heights[x];
+    }
+
+    return botWeights.height * aggregate
+         + botWeights.lines * linesCleared
+         + botWeights.holes * holes
+         + botWeights.bumpiness * bumpiness
+         + botWeights.attack * attack;
+}
+
+BotPlan TetrisBot::plan(const TetrisEngine &engine) const
+{
+    BotPlan best;
+    best.found = false;
+    best.useHold = false;
+    best.score = 0;
+    best.inputCount = 0;
+    if (engine.isGameOver()) return best;
+
+    // 候選：目前的方塊，和 (可以 HOLD 的話) 換出來的那一顆
+    int shapes[2] = {engine.piece().shape, 0};
+    int candidates = 1;
+    if (engine.canHold()) {
+        shapes[1] = engine.heldShape() != 0 ? engine.heldShape() : engine.nextPiece(0);
+        if (shapes[1] != shapes[0]) candidates = 2;
+    }
+
+    static thread_local PlacementSearch search;
+    for (int c = 0; c < candidates; ++c) {
+        // 目前的方塊從它現在的位置開始找，HOLD 換出來的會在出生位置出現
+        int found = c == 0 ? search.run(engine.board(), engine.piece()) : search.run(engine.board(), shapes[c]);
+        int bestIndex = -1;
+        double bestScore = 0;
+        for (int i = 0; i < found; ++i) {
+            TetrisBoard after = engine.board();
+            int lines = placeOnBoard(after, search.landing(i));
+            double score = evaluate(after, lines, engine.attackForLines(lines));
+            if (bestIndex < 0 || score > bestScore) {
+                bestIndex = i;
+                bestScore = score;
+            }
+        }
+        if (bestIndex < 0 || (best.found && bestScore <= best.score)) continue;
+
+        best.found = true;
+        best.useHold = c == 1;
+        best.target = search.landing(bestIndex);
+        best.score = bestScore;
+        best.inputCount = 0;
+        if (best.useHold) best.inputs[best.inputCount++] = INPUT_HOLD;
+        best.inputCount += search.path(bestIndex, best.inputs + best.inputCount, BOT_MAX_PATH - best.inputCount);
+    }
+    return best;
+}
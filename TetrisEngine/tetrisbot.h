@@ -0,0 +1,91 @@
+#ifndef TETRISBOT_H
+#define TETRISBOT_H
+
+#include <cstdint>
+#include "tetrisengine.h"
+
+// 電腦對手：列出目前方塊 (與 HOLD) 所有走得到的落點，用盤面特徵打分數，挑最好的。
+// 搜尋全部在位元盤面上做 (pieceFits)，一顆方塊不到 0.1 ms。
+
+const int BOT_MAX_PATH = 64;
+
+// 特徵權重 (參考 Yiyuan Lee 的 Tetris AI)，attack 是對戰時額外鼓勵送垃圾行
+struct BotWeights
+{
+    double height;
+    double lines;
+    double holes;
+    double bumpiness;
+    double attack;
+};
+
+const BotWeights DEFAULT_BOT_WEIGHTS = {-0.510066, 0.760666, -0.35663, -0.184483, 0.5};
+
+// 對一個盤面與一種方塊做 BFS，找出從出生位置走得到的所有落點。
+// 移動只有左、右、旋轉 (跟 engine 一樣的踢牆) 和「直接落到底」，所以也找得到落地後再滑進去的位置。
+class PlacementSearch
+{
+public:
+    static const int GRID_X_OFFSET = 3;
+    static const int GRID_Y_OFFSET = 4;     // 被垃圾行往上推的方塊 y 會是負的
+    static const int GRID_W = GAME_COLS + GRID_X_OFFSET;
+    static const int GRID_H = GAME_ROWS + GRID_Y_OFFSET;
+    static const int GRID_SIZE = 4 * GRID_H * GRID_W;
+
+    // 從出生位置 (或指定的起點) 開始搜尋，回傳落點數量；起點放不下回傳 0
+    int run(const TetrisBoard &board, int shape);
+    int run(const TetrisBoard &board, const TetrisPiece &start);
+
+    int count() const { return landingCount; }
+    const TetrisPiece &landing(int index) const { return landings[index]; }
+
+    // 走到第 index 個落點的輸入 (最後一個一定是 INPUT_HARD_DROP)，回傳輸入數量
+    int path(int index, TetrisInput *out, int maxInputs) const;
+
+private:
+    enum Move : uint8_t { MOVE_NONE, MOVE_LEFT, MOVE_RIGHT, MOVE_ROTATE, MOVE_DROP };
+
+    static int nodeOf(int rotation, int x, int y) { return (rotation * GRID_H + y + GRID_Y_OFFSET) * GRID_W + x + GRID_X_OFFSET; }
+    static int nodeY(int node) { return (node / GRID_W) % GRID_H - GRID_Y_OFFSET; }
+    bool visit(int node, int from, Move move, int *queue, int &tail);
+
+    const TetrisBoard *board;
+    int shape;
+    int16_t parent[GRID_SIZE];
+    uint8_t via[GRID_SIZE];
+    bool seen[GRID_SIZE];
+    TetrisPiece landings[GRID_SIZE];
+    int landingNodes[GRID_SIZE];
+    int landingCount;
+};
+
+struct BotPlan
+{
+    bool found;
+    bool useHold;
+    TetrisPiece target;
+    double score;
+    int inputCount;
+    TetrisInput inputs[BOT_MAX_PATH];
+};
+
+class TetrisBot
+{
+public:
+    explicit TetrisBot(const BotWeights &weights = DEFAULT_BOT_WEIGHTS);
+
+    // 只看目前的方塊與 HOLD (一層)
+    BotPlan plan(const TetrisEngine &engine) const;
+
+    // 把方塊鎖到盤面上並消行，回傳消掉的行數 (只有遮罩，顏色不管)
+    static int placeOnBoard(TetrisBoard &board, const TetrisPiece &piece);
+    // attack 由呼叫端照對局的規則算好 (TetrisEngine::attackForLines)
+    double evaluate(const TetrisBoard &board, int linesCleared, int attack) const;
+
+    const BotWeights &weights() const { return botWeights; }
+
+private:
+    BotWeights botWeights;
+};
+
+#endif // TETRISBOT_H
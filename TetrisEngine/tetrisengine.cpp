@@ -0,0 +1,431 @@
+#include "tetrisengine.h"
+#include "piecetables.h"
+#include <algorithm>
+#include <bitset>
+#include <climits>
+#include <cstring>
+
+const uint64_t BAG_STREAM = 1;
+const uint64_t GARBAGE_STREAM = 2;
+
+// --- TetrisBoard ---
+
+void TetrisBoard::clear()
+{
+    std::memset(rows, 0, sizeof(rows));
+    std::memset(colors, 0, sizeof(colors));
+}
+
+uint32_t TetrisBoard::fullRows() const
+{
+    // 固定 20 次比較、沒有分支，編譯器可以直接向量化
+    uint32_t mask = 0;
+    for (int y = 0; y < GAME_ROWS; ++y) mask |= uint32_t(rows[y] == FULL_ROW_MASK) << y;
+    return mask;
+}
+
+void TetrisBoard::removeRows(uint32_t rowMask)
+{
+    if (rowMask == 0) return;
+
+    // 由下往上，把每一段連續保留的列整段 memmove 到最終位置，不管消幾行都只走一遍
+    int write = GAME_ROWS;
+    int y = GAME_ROWS;
+    while (y > 0) {
+        int end = y;
+        while (y > 0 && !((rowMask >> (y - 1)) & 1u)) y--;
+        int len = end - y;
+        if (len > 0 && write != end) {
+            std::memmove(rows + write - len, rows + y, len * sizeof(rows[0]));
+            std::memmove(colors + write - len, colors + y, len * sizeof(colors[0]));
+        }
+        write -= len;
+        while (y > 0 && ((rowMask >> (y - 1)) & 1u)) y--;
+    }
+    std::memset(rows, 0, write * sizeof(rows[0]));
+    std::memset(colors, 0, write * sizeof(colors[0]));
+}
+
+void TetrisBoard::setCell(int x, int y, int color)
+{
+    colors[y][x] = static_cast<uint8_t>(color);
+    if (color != 0) rows[y] |= static_cast<uint16_t>(1u << x);
+    else rows[y] &= static_cast<uint16_t>(~(1u << x));
+}
+
+// --- TetrisEngine ---
+
+TetrisEngine::TetrisEngine()
+    : ruleSet(DEFAULT_RULES), boardRevision(0)
+{
+    reset(0);
+}
+
+void TetrisEngine::reset(uint32_t seed)
+{
+    field.clear();
+    boardRevision++;
+    matchSeed = seed;
+    bagRng.seed(seed, BAG_STREAM);
+    garbageRng.seed(seed, GARBAGE_STREAM);
+
+    held = 0;
+    holdAvailable = true;
+    points = 0;
+    currentLevel = 1;
+    gameOver = false;
+
+    bagPos = 7;
+    queueHead = 0;
+    for (int i = 0; i < NEXT_QUEUE_SIZE; ++i) queue[i] = drawFromBag();
+
+    spawnPiece();
+}
+
+bool pieceFits(const TetrisBoard &board, int shape, int rotation, int x, int y)
+{
+    if (shape < 1 || shape > 7) return false;
+    const PieceMask &m = pieceMask(shape, rotation);
+    int left = x + m.minX;
+    if (left < 0 || x + m.maxX >= GAME_COLS || y + m.maxY >= GAME_ROWS) return false;
+
+    // 每列只要一次 AND，盤面上方 (y < 0) 視為空
+    for (int r = m.minY; r <= m.maxY; ++r) {
+        int by = y + r;
+        if (by >= 0 && (board.rows[by] & (m.rows[r] << left))) return false;
+    }
+    return true;
+}
+
+bool TetrisEngine::fits(int shape, int rotation, int x, int y) const
+{
+    return pieceFits(field, shape, rotation, x, y);
+}
+
+bool TetrisEngine::tryMove(int newX, int newY, int newRot) const
+{
+    return fits(current.shape, newRot, newX, newY);
+}
+
+int TetrisEngine::ghostY() const
+{
+    int y = current.y;
+    while (tryMove(current.x, y + 1, current.rotation)) y++;
+    return y;
+}
+
+bool TetrisEngine::moveLeft()
+{
+    if (gameOver || !tryMove(current.x - 1, current.y, current.rotation)) return false;
+    current.x--;
+    return true;
+}
+
+bool TetrisEngine::moveRight()
+{
+    if (gameOver || !tryMove(current.x + 1, current.y, current.rotation)) return false;
+    current.x++;
+    return true;
+}
+
+bool TetrisEngine::moveDown()
+{
+    if (gameOver || !tryMove(current.x, current.y + 1, current.rotation)) return false;
+    current.y++;
+    return true;
+}
+
+bool TetrisEngine::step()
+{
+    return moveDown();
+}
+
+bool TetrisEngine::rotate()
+{
+    if (gameOver) return false;
+    int nextRot = (current.rotation + 1) % 4;
+    if (tryMove(current.x, current.y, nextRot)) { current.rotation = nextRot; return true; }
+    if (tryMove(current.x + 1, current.y, nextRot)) { current.x += 1; current.rotation = nextRot; return true; }
+    if (tryMove(current.x - 1, current.y, nextRot)) { current.x -= 1; current.rotation = nextRot; return true; }
+    return false;
+}
+
+bool TetrisEngine::hold()
+{
+    if (gameOver || !holdAvailable) return false;
+
+    if (held == 0) {
+        held = current.shape;
+        spawnPiece();
+    } else {
+        std::swap(current.shape, held);
+        current.x = GAME_COLS / 2 - 1;
+        current.y = 0;
+        current.rotation = 0;
+        if (!tryMove(current.x, current.y, current.rotation)) gameOver = true;
+    }
+    holdAvailable = false;
+    return true;
+}
+
+LockResult TetrisEngine::hardDrop()
+{
+    if (!gameOver) current.y = ghostY();
+    return lockPiece();
+}
+
+LockResult TetrisEngine::lockPiece()
+{
+    LockResult result = {0, 0, gameOver, current, 0};
+    if (gameOver) return result;
+
+    for (int i = 0; i < 4; ++i) {
+        int x = current.x + SHAPE_CELLS[current.shape][current.rotation][i][0];
+        int y = current.y + SHAPE_CELLS[current.shape][current.rotation][i][1];
+        if (x >= 0 && x < GAME_COLS && y >= 0 && y < GAME_ROWS) field.setCell(x, y, current.shape);
+    }
+
+    boardRevision++;
+    result.clearedRows = clearLines();
+    result.linesCleared = static_cast<int>(std::bitset<GAME_ROWS>(result.clearedRows).count());
+    if (result.linesCleared > 0) {
+        int lines = std::min(result.linesCleared, 4);
+        // 64-bit 算再封頂，規則調得再大也不會溢位
+        int64_t total = int64_t(points) + int64_t(ruleSet.linePoints[lines]) * currentLevel;
+        points = static_cast<int>(std::min<int64_t>(total, INT_MAX));
+        updateGameLevel();
+        result.attack = attackForLines(lines);
+    }
+
+    result.toppedOut = !spawnPiece();
+    return result;
+}
+
+uint32_t TetrisEngine::clearLines()
+{
+    uint32_t full = field.fullRows();
+    field.removeRows(full);
+    return full;
+}
+
+void TetrisEngine::addGarbageLines(int count)
+{
+    int holes[GAME_ROWS];
+    count = peekGarbageHoles(count, holes);
+    addGarbageLines(count, holes);
+}
+
+int TetrisEngine::peekGarbageHoles(int count, int *holes) const
+{
+    if (count <= 0) return 0;
+    if (count >= GAME_ROWS) count = GAME_ROWS - 1;
+    Pcg32 rng = garbageRng;
+    for (int i = 0; i < count; i++) holes[i] = static_cast<int>(rng.bounded(GAME_COLS));
+    return count;
+}
+
+void TetrisEngine::addGarbageLines(int count, const int *holes)
+{
+    if (count <= 0) return;
+    if (count >= GAME_ROWS) count = GAME_ROWS - 1;
+
+    // 洞是別人決定的也照樣讓串流前進，Client / Server / 重播的串流位置才會一致
+    for (int i = 0; i < count; i++) garbageRng.bounded(GAME_COLS);
+
+    std::memmove(field.rows, field.rows + count, (GAME_ROWS - count) * sizeof(field.rows[0]));
+    std::memmove(field.colors, field.colors + count, (GAME_ROWS - count) * sizeof(field.colors[0]));
+
+    for (int i = 0; i < count; i++) {
+        int y = GAME_ROWS - count + i;
+        int hole = ((holes[i] % GAME_COLS) + GAME_COLS) % GAME_COLS;
+        for (int x = 0; x < GAME_COLS; x++) field.colors[y][x] = (x == hole) ? 0 : GARBAGE_COLOR;
+        field.rows[y] = FULL_ROW_MASK & ~(1u << hole);
+    }
+    boardRevision++;
+    if (!gameOver && !tryMove(current.x, current.y, current.rotation)) current.y -= count;
+}
+
+bool TetrisEngine::applyInput(TetrisInput input, LockResult &result)
+{
+    switch (input) {
+    case INPUT_LEFT: moveLeft(); break;
+    case INPUT_RIGHT: moveRight(); break;
+    case INPUT_SOFT_DROP: moveDown(); break;
+    case INPUT_ROTATE: rotate(); break;
+    case INPUT_HOLD: hold(); break;
+    case INPUT_GRAVITY: step(); break;
+    case INPUT_HARD_DROP:
+        if (gameOver) return false;
+        result = hardDrop();
+        return true;
+    case INPUT_LOCK:
+        if (gameOver || tryMove(current.x, current.y + 1, current.rotation)) return false;
+        result = lockPiece();
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+void TetrisEngine::correct(const TetrisBoard &board, const TetrisPiece &piece, int heldShape, bool canHold)
+{
+    field = board;
+    boardRevision++;
+    current = piece;
+    held = heldShape;
+    holdAvailable = canHold;
+}
+
+// --- 狀態存檔 (little endian) ---
+
+static uint8_t *putU32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) *p++ = static_cast<uint8_t>(v >> (i * 8));
+    return p;
+}
+
+static uint8_t *putU64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) *p++ = static_cast<uint8_t>(v >> (i * 8));
+    return p;
+}
+
+static uint32_t getU32(const uint8_t *&p)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= uint32_t(*p++) << (i * 8);
+    return v;
+}
+
+static uint64_t getU64(const uint8_t *&p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= uint64_t(*p++) << (i * 8);
+    return v;
+}
+
+int TetrisEngine::saveState(uint8_t *out) const
+{
+    uint8_t *p = out;
+    for (int y = 0; y < GAME_ROWS; ++y) {
+        *p++ = static_cast<uint8_t>(field.rows[y] & 0xFF);
+        *p++ = static_cast<uint8_t>(field.rows[y] >> 8);
+    }
+    // 顏色 0~8，兩格塞一個位元組
+    for (int y = 0; y < GAME_ROWS; ++y) {
+        for (int x = 0; x < GAME_COLS; x += 2) *p++ = static_cast<uint8_t>(field.colors[y][x] | (field.colors[y][x + 1] << 4));
+    }
+    *p++ = static_cast<uint8_t>(current.shape);
+    *p++ = static_cast<uint8_t>(current.rotation);
+    *p++ = static_cast<uint8_t>(static_cast<int8_t>(current.x));
+    *p++ = static_cast<uint8_t>(static_cast<int8_t>(current.y));
+    *p++ = static_cast<uint8_t>(held);
+    *p++ = holdAvailable ? 1 : 0;
+    for (int i = 0; i < 7; ++i) *p++ = static_cast<uint8_t>(bag[i]);
+    *p++ = static_cast<uint8_t>(bagPos);
+    for (int i = 0; i < NEXT_QUEUE_SIZE; ++i) *p++ = static_cast<uint8_t>(queue[i]);
+    *p++ = static_cast<uint8_t>(queueHead);
+    p = putU32(p, static_cast<uint32_t>(points));
+    p = putU32(p, static_cast<uint32_t>(currentLevel));
+    *p++ = gameOver ? 1 : 0;
+    p = putU32(p, matchSeed);
+    p = putU64(p, bagRng.state);
+    p = putU64(p, bagRng.inc);
+    p = putU64(p, garbageRng.state);
+    p = putU64(p, garbageRng.inc);
+    return static_cast<int>(p - out);
+}
+
+bool TetrisEngine::loadState(const uint8_t *in, int size)
+{
+    if (size < STATE_SIZE) return false;
+
+    // 先讀到暫存的 engine，檢查過才換掉，壞掉的快照不會留下半套狀態
+    TetrisEngine next(*this);
+    const uint8_t *p = in;
+    for (int y = 0; y < GAME_ROWS; ++y, p += 2) {
+        next.field.rows[y] = static_cast<uint16_t>(p[0] | (p[1] << 8));
+        if (next.field.rows[y] & ~FULL_ROW_MASK) return false;
+    }
+    for (int y = 0; y < GAME_ROWS; ++y) {
+        for (int x = 0; x < GAME_COLS; x += 2, ++p) {
+            next.field.colors[y][x] = *p & 0x0F;
+            next.field.colors[y][x + 1] = *p >> 4;
+        }
+    }
+    next.current.shape = *p++;
+    next.current.rotation = *p++;
+    next.current.x = static_cast<int8_t>(*p++);
+    next.current.y = static_cast<int8_t>(*p++);
+    next.held = *p++;
+    next.holdAvailable = *p++ != 0;
+    for (int i = 0; i < 7; ++i) next.bag[i] = *p++;
+    next.bagPos = *p++;
+    for (int i = 0; i < NEXT_QUEUE_SIZE; ++i) next.queue[i] = *p++;
+    next.queueHead = *p++;
+    next.points = static_cast<int>(getU32(p));
+    next.currentLevel = static_cast<int>(getU32(p));
+    next.gameOver = *p++ != 0;
+    next.matchSeed = getU32(p);
+    next.bagRng.state = getU64(p);
+    next.bagRng.inc = getU64(p);
+    next.garbageRng.state = getU64(p);
+    next.garbageRng.inc = getU64(p);
+
+    if (next.current.shape > 7 || next.current.rotation > 3 || next.held > 7 || next.bagPos > 7 || next.queueHead >= NEXT_QUEUE_SIZE) return false;
+    next.boardRevision++;
+    *this = next;
+    return true;
+}
+
+int TetrisEngine::attackForLines(int linesCleared) const
+{
+    if (linesCleared <= 0) return 0;
+    return ruleSet.attackTable[std::min(linesCleared, 4)];
+}
+
+int TetrisEngine::dropSpeed() const
+{
+    return std::max(ruleSet.minDropMs, ruleSet.baseDropMs - (currentLevel - 1) * ruleSet.dropStepMs);
+}
+
+void TetrisEngine::updateGameLevel()
+{
+    int newLevel = std::min(std::max(1, ruleSet.maxLevel), (points / std::max(1, ruleSet.pointsPerLevel)) + 1);
+    if (newLevel > currentLevel) currentLevel = newLevel;
+}
+
+bool TetrisEngine::spawnPiece()
+{
+    current.shape = takeNextPiece();
+    current.rotation = 0;
+    current.x = GAME_COLS / 2 - 1;
+    current.y = 0;
+    holdAvailable = true;
+
+    if (!tryMove(current.x, current.y, current.rotation)) gameOver = true;
+    return !gameOver;
+}
+
+int TetrisEngine::takeNextPiece()
+{
+    int shape = queue[queueHead];
+    queue[queueHead] = drawFromBag();
+    queueHead = (queueHead + 1) % NEXT_QUEUE_SIZE;
+    return shape;
+}
+
+int TetrisEngine::drawFromBag()
+{
+    if (bagPos >= 7) refillBag();
+    return bag[bagPos++];
+}
+
+void TetrisEngine::refillBag()
+{
+    // 自己做 Fisher-Yates：std::shuffle 在不同標準函式庫的實作不一樣
+    for (int i = 0; i < 7; ++i) bag[i] = i + 1;
+    for (int i = 6; i > 0; --i) std::swap(bag[i], bag[bagRng.bounded(i + 1)]);
+    bagPos = 0;
+}
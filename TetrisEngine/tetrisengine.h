@@ -0,0 +1,163 @@
+#ifndef TETRISENGINE_H
+#define TETRISENGINE_H
+
+#include <cstdint>
+#include "pcg32.h"
+
+// 純 C++ 的遊戲規則核心：不依賴 QtWidgets，所有狀態都是固定大小陣列，
+// 操作過程不會配置記憶體，可以給 Server 或 Bot 直接使用。
+
+const int GAME_COLS = 10;
+const int GAME_ROWS = 20;
+const int NEXT_QUEUE_SIZE = 5;
+const int GARBAGE_COLOR = 8;
+const uint16_t FULL_ROW_MASK = (1u << GAME_COLS) - 1;
+
+// 盤面：每一列用 16-bit 遮罩記錄佔用 (bit x = 第 x 欄)，另外用一個顏色平面記錄方塊種類
+// 顏色：0 = 空, 1~7 = 方塊, 8 = 垃圾行
+struct TetrisBoard
+{
+    uint16_t rows[GAME_ROWS];
+    uint8_t colors[GAME_ROWS][GAME_COLS];
+
+    void clear();
+    uint32_t fullRows() const;          // bit y = 第 y 列已滿
+    void removeRows(uint32_t rowMask);  // 一次移除多列並把上方壓下來
+    bool isOccupied(int x, int y) const { return (rows[y] >> x) & 1u; }
+    int cell(int x, int y) const { return colors[y][x]; }
+    void setCell(int x, int y, int color);
+};
+
+// 方塊放在 (x, y) 會不會撞到盤面或出界，Bot 搜尋時直接拿盤面來問
+bool pieceFits(const TetrisBoard &board, int shape, int rotation, int x, int y);
+
+struct TetrisPiece
+{
+    int shape;
+    int rotation;
+    int x;
+    int y;
+};
+
+// 方塊鎖定後的結果，讓呼叫端決定要播音效、送攻擊或結束遊戲
+struct LockResult
+{
+    int linesCleared;
+    int attack;
+    bool toppedOut;
+    TetrisPiece placed;     // 被鎖定的方塊 (鎖定時的位置)
+    uint32_t clearedRows;   // bit y = 鎖定後消掉的第 y 列 (消行前的座標)
+};
+
+// 可以調整的規則 (模擬器拿來比較不同設定)，DEFAULT_RULES 就是原本遊戲的規則
+struct TetrisRules
+{
+    int linePoints[5];      // 消 0~4 行的分數 (再乘上等級)
+    int pointsPerLevel;     // 每幾分升一級
+    int maxLevel;           // 等級上限：分數倍率跟著等級、等級又跟著分數，不封頂的話分數會指數成長
+    int baseDropMs;         // 第 1 級的重力間隔
+    int dropStepMs;         // 每升一級快多少
+    int minDropMs;
+    int attackTable[5];     // 消 0~4 行送出的垃圾行
+};
+
+const TetrisRules DEFAULT_RULES = {{0, 100, 300, 500, 800}, 1000, 20, 1000, 100, 100, {0, 0, 1, 2, 3}};
+
+// 玩家的輸入 (含計時器產生的重力與鎖定)，Server 權威模式用同一串輸入重跑規則
+enum TetrisInput : uint8_t {
+    INPUT_LEFT = 0,
+    INPUT_RIGHT,
+    INPUT_SOFT_DROP,
+    INPUT_ROTATE,
+    INPUT_HARD_DROP,
+    INPUT_HOLD,
+    INPUT_GRAVITY,      // 重力計時器往下一格
+    INPUT_LOCK,         // 鎖定計時器到期 (已著地才會鎖定)
+    INPUT_COUNT
+};
+
+class TetrisEngine
+{
+public:
+    TetrisEngine();
+
+    // 同一個種子 + 同一串輸入 (含垃圾行) 會得到完全一樣的對局
+    void reset(uint32_t seed);
+    void setRules(const TetrisRules &rules) { ruleSet = rules; }
+    const TetrisRules &rules() const { return ruleSet; }
+
+    // --- 操作 (成功移動回傳 true) ---
+    bool moveLeft();
+    bool moveRight();
+    bool moveDown();
+    bool rotate();          // 含簡單踢牆 (原位 -> 右 1 -> 左 1)
+    bool hold();
+    bool step();            // 重力下降一格，已著地回傳 false
+    LockResult hardDrop();
+    LockResult lockPiece();
+    void addGarbageLines(int count);                    // 洞從垃圾行的亂數串流抽
+    void addGarbageLines(int count, const int *holes);  // 指定每一行的洞 (由下往上數第 i 行)
+    int peekGarbageHoles(int count, int *holes) const;  // 預看接下來的洞 (不前進)，回傳實際行數
+
+    // 套用一個輸入，有方塊鎖定時回傳 true 並填好 result
+    bool applyInput(TetrisInput input, LockResult &result);
+
+    // Server 權威模式的校正：直接換成 Server 算出來的盤面與方塊
+    void correct(const TetrisBoard &board, const TetrisPiece &piece, int heldShape, bool canHold);
+
+    // --- 查詢 ---
+    bool tryMove(int newX, int newY, int newRot) const;
+    bool fits(int shape, int rotation, int x, int y) const;
+    int ghostY() const;
+
+    const TetrisBoard &board() const { return field; }
+    const TetrisPiece &piece() const { return current; }
+    int heldShape() const { return held; }
+    bool canHold() const { return holdAvailable; }
+    int nextPiece(int index) const { return queue[(queueHead + index) % NEXT_QUEUE_SIZE]; }
+    int score() const { return points; }
+    int level() const { return currentLevel; }
+    int dropSpeed() const;
+    bool isGameOver() const { return gameOver; }
+    uint32_t seed() const { return matchSeed; }
+    uint32_t revision() const { return boardRevision; }    // 已鎖定的格子有變就 +1 (畫面快取用)
+
+    int attackForLines(int linesCleared) const;     // 照這個 engine 的規則 (Bot 評分要跟實際送出的一樣)
+
+    // 完整狀態 (含亂數串流) 存成固定長度、跟平台無關的位元組，重播快照與快轉用
+    static const int STATE_SIZE = 205;
+    int saveState(uint8_t *out) const;
+    bool loadState(const uint8_t *in, int size);
+
+private:
+    bool spawnPiece();
+    int takeNextPiece();
+    int drawFromBag();
+    void refillBag();
+    uint32_t clearLines();
+    void updateGameLevel();
+
+    TetrisRules ruleSet;    // 設定，不算在 saveState 的狀態裡
+    TetrisBoard field;
+    uint32_t boardRevision;
+    TetrisPiece current;
+
+    int held;
+    bool holdAvailable;
+
+    int bag[7];
+    int bagPos;
+    int queue[NEXT_QUEUE_SIZE];
+    int queueHead;
+
+    int points;
+    int currentLevel;
+    bool gameOver;
+
+    // 方塊與垃圾行各用一個串流，收到攻擊不會打亂之後的方塊順序
+    uint32_t matchSeed;
+    Pcg32 bagRng;
+    Pcg32 garbageRng;
+};
+
+#endif // TETRISENGINE_H
@@ -0,0 +1,99 @@
+#include "ticker.h"
+#include <algorithm>
+
+static const int UNITS_PER_TICK = 1000;
+
+static int unitsPerCell(const TetrisEngine &engine)
+{
+    return std::max(1, engine.dropSpeed()) * TICKS_PER_SECOND;
+}
+
+TetrisTicker::TetrisTicker()
+{
+    reset();
+}
+
+void TetrisTicker::reset()
+{
+    frameCount = 0;
+    gravityUnits = 0;
+    lockCounter = 0;
+    lockResets = 0;
+    lowestY = 0;
+}
+
+bool TetrisTicker::grounded(const TetrisEngine &engine)
+{
+    const TetrisPiece &piece = engine.piece();
+    return !engine.tryMove(piece.x, piece.y + 1, piece.rotation);
+}
+
+void TetrisTicker::trackLowest(const TetrisEngine &engine)
+{
+    if (engine.piece().y > lowestY) {
+        lowestY = engine.piece().y;
+        lockResets = 0;
+    }
+}
+
+TickResult TetrisTicker::tick(TetrisEngine &engine, const TickInputObserver &observer)
+{
+    TickResult result;
+    result.gravitySteps = 0;
+    result.locked = false;
+    frameCount++;
+    if (engine.isGameOver()) return result;
+
+    // 重力：著地時不累積，離開地面才重新開始算
+    if (grounded(engine)) {
+        gravityUnits = 0;
+    } else {
+        gravityUnits += UNITS_PER_TICK;
+        int cell = unitsPerCell(engine);
+        while (gravityUnits >= cell) {
+            gravityUnits -= cell;
+            if (observer) observer(INPUT_GRAVITY);
+            engine.applyInput(INPUT_GRAVITY, result.lock);
+            result.gravitySteps++;
+            if (grounded(engine)) {
+                gravityUnits = 0;
+                break;
+            }
+        }
+        trackLowest(engine);
+    }
+
+    if (!grounded(engine)) {
+        lockCounter = 0;
+        return result;
+    }
+    if (++lockCounter < LOCK_DELAY_TICKS) return result;
+
+    if (observer) observer(INPUT_LOCK);
+    result.locked = engine.applyInput(INPUT_LOCK, result.lock);
+    pieceSpawned(engine);
+    return result;
+}
+
+void TetrisTicker::pieceMoved(const TetrisEngine &engine)
+{
+    trackLowest(engine);
+    if (lockCounter > 0 && lockResets < MAX_LOCK_RESETS) {
+        lockCounter = 0;
+        lockResets++;
+    }
+}
+
+void TetrisTicker::pieceSpawned(const TetrisEngine &engine)
+{
+    gravityUnits = 0;
+    lockCounter = 0;
+    lockResets = 0;
+    lowestY = engine.piece().y;
+}
+
+double TetrisTicker::fallProgress(const TetrisEngine &engine) const
+{
+    if (engine.isGameOver() || grounded(engine)) return 0.0;
+    return std::min(1.0, double(gravityUnits) / unitsPerCell(engine));
+}
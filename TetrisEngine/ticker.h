@@ -0,0 +1,55 @@
+#ifndef TICKER_H
+#define TICKER_H
+
+#include <cstdint>
+#include <functional>
+#include "tetrisengine.h"
+
+// 固定步長的遊戲時間軸：每秒 60 個 tick，跟畫面更新、Qt 計時器的誤差無關。
+// 重力用累加器 (每 tick 累加 1000，一格 = dropSpeed * 60)，全部整數運算，高等級時一個 tick 可以掉好幾格；
+// 著地後等 LOCK_DELAY_TICKS 才鎖定，期間成功移動/旋轉會重新計時 (每顆最多 MAX_LOCK_RESETS 次，
+// 到了更低的一列次數歸零)。產生的 GRAVITY / LOCK 跟玩家輸入一樣錄進重播、送給 Server，重跑結果不變。
+
+const int TICKS_PER_SECOND = 60;
+const int LOCK_DELAY_TICKS = 30;        // 0.5 秒
+const int MAX_LOCK_RESETS = 15;
+
+struct TickResult
+{
+    int gravitySteps;       // 這個 tick 掉了幾格
+    bool locked;
+    LockResult lock;
+};
+
+// 每個產生的輸入在套用之前先通知 (錄重播、送給 Server)，這時 engine 還是套用前的狀態
+typedef std::function<void(TetrisInput)> TickInputObserver;
+
+class TetrisTicker
+{
+public:
+    TetrisTicker();
+
+    void reset();
+    TickResult tick(TetrisEngine &engine, const TickInputObserver &observer = TickInputObserver());
+
+    // 玩家的操作成功後呼叫：移動/旋轉/軟降 -> pieceMoved，鎖定或 HOLD 換了方塊 -> pieceSpawned
+    void pieceMoved(const TetrisEngine &engine);
+    void pieceSpawned(const TetrisEngine &engine);
+
+    uint32_t frame() const { return frameCount; }
+    // 距離下一次重力還有多少 (0~1)，畫面用來內插方塊的高度；著地時是 0
+    double fallProgress(const TetrisEngine &engine) const;
+    int lockTicks() const { return lockCounter; }
+
+private:
+    static bool grounded(const TetrisEngine &engine);
+    void trackLowest(const TetrisEngine &engine);
+
+    uint32_t frameCount;
+    int gravityUnits;
+    int lockCounter;
+    int lockResets;
+    int lowestY;
+};
+
+#endif // TICKER_H
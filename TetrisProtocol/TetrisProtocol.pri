@@ -0,0 +1,13 @@
+# Client 與 Server 共用的二進位封包編解碼 (純 C++，需要 TetrisEngine.pri 的 TetrisBoard)
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/clocksync.cpp \
+    $$PWD/framedecoder.cpp \
+    $$PWD/protocol.cpp
+
+HEADERS += \
+    $$PWD/clocksync.h \
+    $$PWD/framedecoder.h \
+    $$PWD/protocol.h
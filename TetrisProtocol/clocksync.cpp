@@ -0,0 +1,47 @@
+#include "clocksync.h"
+#include <algorithm>
+
+ClockSync::ClockSync()
+    : pingId(0)
+{
+    reset();
+}
+
+void ClockSync::reset()
+{
+    next = 0;
+    samples = 0;
+    smoothedRtt = 0;
+    latestRtt = 0;
+    rttJitter = 0;
+    bestRtt = 0;
+    bestOffset = 0;
+}
+
+void ClockSync::addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3)
+{
+    int64_t rtt = std::max<int64_t>(0, (t3 - t0) - (t2 - t1));
+    int64_t offset = ((t1 - t0) + (t2 - t3)) / 2;
+
+    if (samples == 0) {
+        smoothedRtt = rtt;
+        rttJitter = 0;
+    } else {
+        int64_t change = rtt > latestRtt ? rtt - latestRtt : latestRtt - rtt;
+        rttJitter += (change - rttJitter) / 16;
+        smoothedRtt += (rtt - smoothedRtt) / 8;
+    }
+    latestRtt = rtt;
+
+    window[next] = Sample{rtt, offset};
+    next = (next + 1) % WINDOW;
+    samples++;
+
+    int count = samples < WINDOW ? samples : WINDOW;
+    const Sample *best = &window[0];
+    for (int i = 1; i < count; i++) {
+        if (window[i].rtt < best->rtt) best = &window[i];
+    }
+    bestRtt = best->rtt;
+    bestOffset = best->offset;
+}
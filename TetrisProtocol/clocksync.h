@@ -0,0 +1,50 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <cstdint>
+
+// PING/PONG 的量測結果 (NTP 的算法)：每個 PONG 給一組 t0~t3，
+//   來回時間 = (t3 - t0) - (t2 - t1)，時鐘差 = ((t1 - t0) + (t2 - t3)) / 2  (對方時鐘 - 自己時鐘)
+// 來回時間與抖動用指數平均 (RFC 6298 / RFC 3550 的係數)；時鐘差取最近 WINDOW 次裡來回時間最短的那次，
+// 排隊最少、去回最對稱，誤差最多是那次來回時間的一半。時間單位都是微秒。
+class ClockSync
+{
+public:
+    static const int WINDOW = 16;
+
+    ClockSync();
+    void reset();
+
+    uint16_t nextPingId() { return pingId++; }
+    // t0 / t3 是自己的時鐘 (送出 PING、收到 PONG)，t1 / t2 是對方的時鐘
+    void addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3);
+
+    int sampleCount() const { return samples; }
+    int64_t rtt() const { return smoothedRtt; }
+    int64_t lastRtt() const { return latestRtt; }
+    int64_t minRtt() const { return bestRtt; }
+    int64_t jitter() const { return rttJitter; }
+    int64_t offset() const { return bestOffset; }
+    int64_t oneWayDelay() const { return bestRtt / 2; }
+
+    // 自己的時間換成對方的時間 (例如把垃圾行的時間點對到 Server 的時鐘)
+    int64_t toPeerTime(int64_t localTime) const { return localTime + bestOffset; }
+
+private:
+    struct Sample {
+        int64_t rtt;
+        int64_t offset;
+    };
+
+    Sample window[WINDOW];
+    int next;
+    int samples;
+    uint16_t pingId;
+    int64_t smoothedRtt;
+    int64_t latestRtt;
+    int64_t rttJitter;
+    int64_t bestRtt;
+    int64_t bestOffset;
+};
+
+#endif // CLOCKSYNC_H
@@ -0,0 +1,122 @@
+#include "framedecoder.h"
+#include "protocol.h"
+#include <cstring>
+
+FrameDecoder::FrameDecoder(int capacityLog2)
+    : buffer(new uint8_t[size_t(1) << capacityLog2])
+    , scratch(new uint8_t[size_t(1) << capacityLog2])
+    , size(uint32_t(1) << capacityLog2)
+    , mask((uint32_t(1) << capacityLog2) - 1)
+    , head(0), tail(0), scanned(0), pendingRelease(0)
+{
+}
+
+void FrameDecoder::reset()
+{
+    head = tail = scanned = pendingRelease = 0;
+}
+
+uint8_t *FrameDecoder::writePointer()
+{
+    return buffer.get() + (tail & mask);
+}
+
+int FrameDecoder::writableSize() const
+{
+    uint32_t freeBytes = size - (tail - head);
+    uint32_t untilEnd = size - (tail & mask);
+    return static_cast<int>(freeBytes < untilEnd ? freeBytes : untilEnd);
+}
+
+void FrameDecoder::commit(int bytes)
+{
+    tail += static_cast<uint32_t>(bytes);
+}
+
+const uint8_t *FrameDecoder::contiguous(uint32_t pos, int length)
+{
+    uint32_t start = pos & mask;
+    if (start + uint32_t(length) <= size) return buffer.get() + start;
+
+    // 跨過尾端：分兩段攤平到 scratch
+    uint32_t first = size - start;
+    std::memcpy(scratch.get(), buffer.get() + start, first);
+    std::memcpy(scratch.get() + first, buffer.get(), length - first);
+    return scratch.get();
+}
+
+bool FrameDecoder::findNewline(uint32_t &pos)
+{
+    while (scanned != tail) {
+        uint32_t start = scanned & mask;
+        uint32_t length = tail - scanned;
+        if (start + length > size) length = size - start;
+
+        const void *hit = std::memchr(buffer.get() + start, '\n', length);
+        if (hit) {
+            pos = scanned + uint32_t(static_cast<const uint8_t*>(hit) - (buffer.get() + start));
+            return true;
+        }
+        scanned += length;
+    }
+    return false;
+}
+
+FrameDecoder::Result FrameDecoder::next(Message &message)
+{
+    head += pendingRelease;
+    pendingRelease = 0;
+    if (scanned - head > tail - head) scanned = head; // scanned 落在 head 之前
+
+    while (tail != head) {
+        uint32_t available = tail - head;
+
+        if (byteAt(head) == Protocol::FRAME_MAGIC) {
+            if (available < uint32_t(Protocol::HEADER_SIZE)) return NeedMore;
+
+            uint8_t header[Protocol::HEADER_SIZE];
+            for (int i = 0; i < Protocol::HEADER_SIZE; ++i) header[i] = byteAt(head + i);
+            Protocol::FrameHeader parsed;
+            if (!Protocol::parseHeader(header, parsed)) return Malformed;
+
+            uint32_t frameSize = Protocol::HEADER_SIZE + parsed.payloadSize;
+            if (frameSize > size) return Malformed;
+            if (available < frameSize) return NeedMore;
+
+            message.binary = true;
+            message.type = parsed.type;
+            message.frame = contiguous(head, int(frameSize));
+            message.frameSize = int(frameSize);
+            message.payload = message.frame + Protocol::HEADER_SIZE;
+            message.payloadSize = parsed.payloadSize;
+            pendingRelease = frameSize;
+            scanned = head + frameSize;
+            return MessageReady;
+        }
+
+        uint32_t newline;
+        if (!findNewline(newline)) {
+            if (available >= size) return Malformed; // 一整個 buffer 都沒有換行
+            return NeedMore;
+        }
+
+        uint32_t lineSize = newline - head;
+        if (lineSize == 0) {
+            // 空行直接跳過
+            head += 1;
+            scanned = head;
+            continue;
+        }
+
+        message.binary = false;
+        message.type = 0;
+        message.frame = contiguous(head, int(lineSize + 1));
+        message.frameSize = int(lineSize + 1);
+        message.payload = message.frame;
+        message.payloadSize = int(lineSize);
+        pendingRelease = lineSize + 1;
+        scanned = head + pendingRelease;
+        return MessageReady;
+    }
+    return NeedMore;
+}
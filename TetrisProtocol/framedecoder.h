@@ -0,0 +1,63 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <cstdint>
+#include <memory>
+
+// 每條連線一個的增量解碼器，Client 與 Server 共用。
+// 資料直接從 socket 讀進固定大小的 ring buffer (writePointer / commit)，
+// next() 每次切出一則完整訊息 (JSON 行或二進位封包)，回傳的指標直接指向 buffer 內部，
+// 只有剛好跨過 ring buffer 尾端的訊息才會複製到 scratch 攤平。
+// 指標在下一次呼叫 next() 或 reset() 之前有效。
+class FrameDecoder
+{
+public:
+    enum Result {
+        NeedMore,       // 還沒收完，等下一次 readyRead
+        MessageReady,
+        Malformed       // 版本不認得或訊息比 buffer 還大，連線已經無法同步
+    };
+
+    struct Message
+    {
+        bool binary;
+        int type;                   // 二進位封包的種類 (JSON 行為 0)
+        const uint8_t *payload;     // JSON：整行不含 '\n'；二進位：payload
+        int payloadSize;
+        const uint8_t *frame;       // 含 header / '\n' 的完整原始位元組，轉送時直接用
+        int frameSize;
+    };
+
+    explicit FrameDecoder(int capacityLog2 = 14);
+    FrameDecoder(const FrameDecoder &) = delete;
+    FrameDecoder &operator=(const FrameDecoder &) = delete;
+
+    // 接收：先拿可以直接寫入的連續空間，寫完再 commit
+    uint8_t *writePointer();
+    int writableSize() const;
+    void commit(int bytes);
+
+    Result next(Message &message);
+    void reset();
+
+    int bufferedBytes() const { return static_cast<int>(tail - head); }
+    int capacity() const { return static_cast<int>(size); }
+
+private:
+    uint8_t byteAt(uint32_t pos) const { return buffer[pos & mask]; }
+    const uint8_t *contiguous(uint32_t pos, int length);
+    bool findNewline(uint32_t &pos);
+
+    std::unique_ptr<uint8_t[]> buffer;
+    std::unique_ptr<uint8_t[]> scratch;
+    uint32_t size;
+    uint32_t mask;
+
+    // 絕對位置 (會自然溢位)，實際索引要 & mask
+    uint32_t head;      // 第一個還沒被取走的位元組
+    uint32_t tail;      // 下一個寫入位置
+    uint32_t scanned;   // JSON 行已經找過換行的位置，避免每次從頭掃
+    uint32_t pendingRelease;  // 上一次回傳的訊息長度，下一次 next() 才釋放
+};
+
+#endif // FRAMEDECODER_H
@@ -0,0 +1,421 @@
+#include "protocol.h"
+#include "piecetables.h"
+#include <cstring>
+
+namespace Protocol {
+
+static int messageVersion(int type)
+{
+    if (type >= MSG_PING) return 4;
+    if (type >= MSG_INPUT) return 3;
+    return type >= MSG_KEYFRAME ? 2 : 1;
+}
+
+static void writeHeader(uint8_t *out, int type, int payloadSize)
+{
+    out[0] = FRAME_MAGIC;
+    out[1] = static_cast<uint8_t>(messageVersion(type));
+    out[2] = static_cast<uint8_t>(type);
+    out[3] = static_cast<uint8_t>(payloadSize & 0xFF);
+    out[4] = static_cast<uint8_t>((payloadSize >> 8) & 0xFF);
+}
+
+static uint8_t *writeU16(uint8_t *p, uint16_t value)
+{
+    *p++ = static_cast<uint8_t>(value & 0xFF);
+    *p++ = static_cast<uint8_t>(value >> 8);
+    return p;
+}
+
+static uint16_t readU16(const uint8_t *p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint8_t *writeI64(uint8_t *p, int64_t value)
+{
+    uint64_t bits = static_cast<uint64_t>(value);
+    for (int i = 0; i < 8; i++) *p++ = static_cast<uint8_t>(bits >> (8 * i));
+    return p;
+}
+
+static int64_t readI64(const uint8_t *p)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; i++) bits |= uint64_t(p[i]) << (8 * i);
+    return static_cast<int64_t>(bits);
+}
+
+// 盤面：第一個非空列 + 各列遮罩 + 被佔用格子的顏色 (每格 3 bits，顏色 1~8 存成 0~7)
+static uint8_t *writeBoard(uint8_t *p, const TetrisBoard &board)
+{
+    int top = 0;
+    while (top < GAME_ROWS && board.rows[top] == 0) top++;
+    *p++ = static_cast<uint8_t>(top);
+    for (int y = top; y < GAME_ROWS; y++) p = writeU16(p, board.rows[y]);
+
+    uint32_t acc = 0;
+    int bits = 0;
+    for (int y = top; y < GAME_ROWS; y++) {
+        for (int x = 0; x < GAME_COLS; x++) {
+            if (!board.isOccupied(x, y)) continue;
+            acc |= uint32_t((board.cell(x, y) - 1) & 7) << bits;
+            bits += 3;
+            if (bits >= 8) {
+                *p++ = static_cast<uint8_t>(acc & 0xFF);
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+    }
+    if (bits > 0) *p++ = static_cast<uint8_t>(acc & 0xFF);
+    return p;
+}
+
+static const uint8_t *readBoard(const uint8_t *p, const uint8_t *end, TetrisBoard &board)
+{
+    if (p >= end) return nullptr;
+    int top = *p++;
+    if (top > GAME_ROWS || end - p < (GAME_ROWS - top) * 2) return nullptr;
+
+    board.clear();
+    for (int y = top; y < GAME_ROWS; y++) {
+        uint16_t mask = readU16(p);
+        p += 2;
+        if (mask & ~FULL_ROW_MASK) return nullptr;
+        board.rows[y] = mask;
+    }
+
+    uint32_t acc = 0;
+    int bits = 0;
+    for (int y = top; y < GAME_ROWS; y++) {
+        for (int x = 0; x < GAME_COLS; x++) {
+            if (!board.isOccupied(x, y)) continue;
+            if (bits < 3) {
+                if (p >= end) return nullptr;
+                acc |= uint32_t(*p++) << bits;
+                bits += 8;
+            }
+            board.colors[y][x] = static_cast<uint8_t>((acc & 7) + 1);
+            acc >>= 3;
+            bits -= 3;
+        }
+    }
+    return p;
+}
+
+static uint8_t *writeQueue(uint8_t *p, int hold, int nextCount, const int *next)
+{
+    *p++ = static_cast<uint8_t>(hold);
+    if (nextCount > NEXT_QUEUE_SIZE) nextCount = NEXT_QUEUE_SIZE;
+    *p++ = static_cast<uint8_t>(nextCount);
+    for (int i = 0; i < nextCount; i++) *p++ = static_cast<uint8_t>(next[i]);
+    return p;
+}
+
+static const uint8_t *readQueue(const uint8_t *p, const uint8_t *end, int &hold, int &nextCount, int *next)
+{
+    if (end - p < 2) return nullptr;
+    hold = *p++;
+    nextCount = *p++;
+    if (nextCount > NEXT_QUEUE_SIZE || end - p < nextCount) return nullptr;
+    for (int i = 0; i < nextCount; i++) next[i] = *p++;
+    return p;
+}
+
+static uint8_t *writePiece(uint8_t *p, const TetrisPiece &piece)
+{
+    *p++ = static_cast<uint8_t>(piece.shape);
+    *p++ = static_cast<uint8_t>(piece.rotation);
+    *p++ = static_cast<uint8_t>(static_cast<int8_t>(piece.x));
+    *p++ = static_cast<uint8_t>(static_cast<int8_t>(piece.y));
+    return p;
+}
+
+static const uint8_t *readPiece(const uint8_t *p, const uint8_t *end, TetrisPiece &piece)
+{
+    if (end - p < 4) return nullptr;
+    piece.shape = p[0];
+    piece.rotation = p[1];
+    piece.x = static_cast<int8_t>(p[2]);
+    piece.y = static_cast<int8_t>(p[3]);
+    if (piece.shape > 7 || piece.rotation > 3) return nullptr;
+    return p + 4;
+}
+
+static int finishFrame(uint8_t *out, uint8_t *p, int type)
+{
+    int size = static_cast<int>(p - out);
+    writeHeader(out, type, size - HEADER_SIZE);
+    return size;
+}
+
+bool parseHeader(const uint8_t *data, FrameHeader &header)
+{
+    if (data[0] != FRAME_MAGIC) return false;
+    header.version = data[1];
+    header.type = data[2];
+    header.payloadSize = data[3] | (data[4] << 8);
+    return header.version >= 1 && header.version <= PROTOCOL_VERSION;
+}
+
+// --- v1 ---
+
+int encodeGameState(const GameState &state, uint8_t *out)
+{
+    uint8_t *p = writeBoard(out + HEADER_SIZE, state.board);
+    p = writeQueue(p, state.hold, state.nextCount, state.next);
+    return finishFrame(out, p, MSG_GAME_STATE);
+}
+
+bool decodeGameState(const uint8_t *payload, int size, GameState &state)
+{
+    const uint8_t *end = payload + size;
+    const uint8_t *p = readBoard(payload, end, state.board);
+    if (!p) return false;
+    return readQueue(p, end, state.hold, state.nextCount, state.next) != nullptr;
+}
+
+int encodeAttack(int lines, uint8_t *out)
+{
+    out[HEADER_SIZE] = static_cast<uint8_t>(lines < 0 ? 0 : (lines > 255 ? 255 : lines));
+    writeHeader(out, MSG_ATTACK, 1);
+    return HEADER_SIZE + 1;
+}
+
+bool decodeAttack(const uint8_t *payload, int size, int &lines)
+{
+    if (size < 1) return false;
+    lines = payload[0];
+    return true;
+}
+
+int encodeGameOver(uint8_t *out, int result)
+{
+    out[HEADER_SIZE] = static_cast<uint8_t>(result);
+    writeHeader(out, MSG_GAME_OVER, 1);
+    return HEADER_SIZE + 1;
+}
+
+int decodeGameOver(const uint8_t *payload, int size)
+{
+    return size >= 1 ? int(payload[0]) : int(RESULT_OPPONENT_LOST);
+}
+
+// --- v2 ---
+
+int encodeKeyframe(const Keyframe &keyframe, uint8_t *out)
+{
+    uint8_t *p = writeU16(out + HEADER_SIZE, keyframe.seq);
+    p = writePiece(p, keyframe.piece);
+    p = writeQueue(p, keyframe.hold, keyframe.nextCount, keyframe.next);
+    p = writeBoard(p, keyframe.board);
+    return finishFrame(out, p, MSG_KEYFRAME);
+}
+
+bool decodeKeyframe(const uint8_t *payload, int size, Keyframe &keyframe)
+{
+    const uint8_t *end = payload + size;
+    if (size < 2) return false;
+    keyframe.seq = readU16(payload);
+    const uint8_t *p = readPiece(payload + 2, end, keyframe.piece);
+    if (p) p = readQueue(p, end, keyframe.hold, keyframe.nextCount, keyframe.next);
+    if (p) p = readBoard(p, end, keyframe.board);
+    return p != nullptr;
+}
+
+int encodePiece(uint16_t seq, const TetrisPiece &piece, uint8_t *out)
+{
+    uint8_t *p = writeU16(out + HEADER_SIZE, seq);
+    p = writePiece(p, piece);
+    return finishFrame(out, p, MSG_PIECE);
+}
+
+bool decodePiece(const uint8_t *payload, int size, uint16_t &seq, TetrisPiece &piece)
+{
+    if (size < 2) return false;
+    seq = readU16(payload);
+    return readPiece(payload + 2, payload + size, piece) != nullptr;
+}
+
+int encodePlacement(const Placement &placement, uint8_t *out)
+{
+    uint8_t *p = writeU16(out + HEADER_SIZE, placement.seq);
+    p = writePiece(p, placement.piece);
+    // 20 列只需要 3 個位元組
+    *p++ = static_cast<uint8_t>(placement.clearedRows & 0xFF);
+    *p++ = static_cast<uint8_t>((placement.clearedRows >> 8) & 0xFF);
+    *p++ = static_cast<uint8_t>((placement.clearedRows >> 16) & 0xFF);
+    return finishFrame(out, p, MSG_PLACE);
+}
+
+bool decodePlacement(const uint8_t *payload, int size, Placement &placement)
+{
+    const uint8_t *end = payload + size;
+    if (size < 2) return false;
+    placement.seq = readU16(payload);
+    const uint8_t *p = readPiece(payload + 2, end, placement.piece);
+    if (!p || end - p < 3) return false;
+    placement.clearedRows = (uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16)) & ((1u << GAME_ROWS) - 1);
+    return true;
+}
+
+int encodeQueue(const QueueUpdate &queue, uint8_t *out)
+{
+    uint8_t *p = writeU16(out + HEADER_SIZE, queue.seq);
+    p = writeQueue(p, queue.hold, queue.nextCount, queue.next);
+    return finishFrame(out, p, MSG_QUEUE);
+}
+
+bool decodeQueue(const uint8_t *payload, int size, QueueUpdate &queue)
+{
+    if (size < 2) return false;
+    queue.seq = readU16(payload);
+    return readQueue(payload + 2, payload + size, queue.hold, queue.nextCount, queue.next) != nullptr;
+}
+
+int encodeKeyframeRequest(uint8_t *out)
+{
+    writeHeader(out, MSG_KEYFRAME_REQUEST, 0);
+    return HEADER_SIZE;
+}
+
+void stampPiece(TetrisBoard &board, const TetrisPiece &piece)
+{
+    if (piece.shape < 1 || piece.shape > 7) return;
+    for (const auto &cell : SHAPE_CELLS[piece.shape][piece.rotation]) {
+        int x = piece.x + cell[0];
+        int y = piece.y + cell[1];
+        if (x >= 0 && x < GAME_COLS && y >= 0 && y < GAME_ROWS) board.setCell(x, y, piece.shape);
+    }
+}
+
+void applyPlacement(TetrisBoard &board, const Placement &placement)
+{
+    stampPiece(board, placement.piece);
+    board.removeRows(placement.clearedRows);
+}
+
+// --- v3 ---
+
+int encodeInputs(uint16_t firstSeq, const uint8_t *inputs, int count, uint8_t *out)
+{
+    if (count > MAX_INPUT_BATCH) count = MAX_INPUT_BATCH;
+    uint8_t *p = writeU16(out + HEADER_SIZE, firstSeq);
+    *p++ = static_cast<uint8_t>(count);
+    for (int i = 0; i < count; i++) *p++ = inputs[i];
+    return finishFrame(out, p, MSG_INPUT);
+}
+
+bool decodeInputs(const uint8_t *payload, int size, uint16_t &firstSeq, const uint8_t *&inputs, int &count)
+{
+    if (size < 3) return false;
+    firstSeq = readU16(payload);
+    count = payload[2];
+    if (count > MAX_INPUT_BATCH || size - 3 < count) return false;
+    inputs = payload + 3;
+    for (int i = 0; i < count; i++) {
+        if (inputs[i] >= INPUT_COUNT) return false;
+    }
+    return true;
+}
+
+int encodeGarbage(const Garbage &garbage, uint8_t *out)
+{
+    int count = garbage.count < 0 ? 0 : (garbage.count >= GAME_ROWS ? GAME_ROWS - 1 : garbage.count);
+    uint8_t *p = writeU16(out + HEADER_SIZE, garbage.ackInput);
+    *p++ = static_cast<uint8_t>(count);
+    for (int i = 0; i < count; i++) *p++ = static_cast<uint8_t>(garbage.holes[i]);
+    return finishFrame(out, p, MSG_GARBAGE);
+}
+
+bool decodeGarbage(const uint8_t *payload, int size, Garbage &garbage)
+{
+    if (size < 3) return false;
+    garbage.ackInput = readU16(payload);
+    garbage.count = payload[2];
+    if (garbage.count >= GAME_ROWS || size - 3 < garbage.count) return false;
+    for (int i = 0; i < garbage.count; i++) {
+        garbage.holes[i] = payload[3 + i];
+        if (garbage.holes[i] >= GAME_COLS) return false;
+    }
+    return true;
+}
+
+int encodeSync(const Sync &sync, uint8_t *out)
+{
+    uint8_t *p = writeU16(out + HEADER_SIZE, sync.ackInput);
+    p = writePiece(p, sync.piece);
+    *p++ = static_cast<uint8_t>(sync.hold);
+    *p++ = sync.canHold ? 1 : 0;
+    p = writeBoard(p, sync.board);
+    return finishFrame(out, p, MSG_SYNC);
+}
+
+bool decodeSync(const uint8_t *payload, int size, Sync &sync)
+{
+    const uint8_t *end = payload + size;
+    if (size < 2) return false;
+    sync.ackInput = readU16(payload);
+    const uint8_t *p = readPiece(payload + 2, end, sync.piece); // 種類與方向在 readPiece 檢查
+    if (!p || end - p < 2) return false;
+    sync.hold = *p++;
+    sync.canHold = *p++ != 0;
+    if (sync.hold > 7) return false; // 之後直接拿來查方塊表
+    return readBoard(p, end, sync.board) != nullptr;
+}
+
+int encodeSpectate(int slot, const uint8_t *frame, int frameSize, uint8_t *out)
+{
+    uint8_t *p = out + HEADER_SIZE;
+    *p++ = static_cast<uint8_t>(slot);
+    std::memcpy(p, frame, frameSize);
+    return finishFrame(out, p + frameSize, MSG_SPECTATE);
+}
+
+bool decodeSpectate(const uint8_t *payload, int size, int &slot, const uint8_t *&frame, int &frameSize)
+{
+    if (size < 1 + HEADER_SIZE || payload[0] > 1) return false;
+    slot = payload[0];
+    frame = payload + 1;
+    frameSize = size - 1;
+    return true;
+}
+
+// --- v4 ---
+
+int encodePing(uint16_t id, int64_t t0, uint8_t *out)
+{
+    uint8_t *p = writeU16(out + HEADER_SIZE, id);
+    p = writeI64(p, t0);
+    return finishFrame(out, p, MSG_PING);
+}
+
+bool decodePing(const uint8_t *payload, int size, uint16_t &id, int64_t &t0)
+{
+    if (size < 2 + 8) return false;
+    id = readU16(payload);
+    t0 = readI64(payload + 2);
+    return true;
+}
+
+int encodePong(const Pong &pong, uint8_t *out)
+{
+    uint8_t *p = writeU16(out + HEADER_SIZE, pong.id);
+    p = writeI64(p, pong.t0);
+    p = writeI64(p, pong.t1);
+    p = writeI64(p, pong.t2);
+    return finishFrame(out, p, MSG_PONG);
+}
+
+bool decodePong(const uint8_t *payload, int size, Pong &pong)
+{
+    if (size < 2 + 8 * 3) return false;
+    pong.id = readU16(payload);
+    pong.t0 = readI64(payload + 2);
+    pong.t1 = readI64(payload + 10);
+    pong.t2 = readI64(payload + 18);
+    return true;
+}
+
+} // namespace Protocol
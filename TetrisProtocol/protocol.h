@@ -0,0 +1,189 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include "tetrisengine.h"
+
+// 二進位封包格式：
+//   [0] FRAME_MAGIC   (0xF5，不可能是 JSON 行的開頭，所以兩種格式可以混在同一條連線上)
+//   [1] 版本 (定義這種訊息的協定版本，v1 的訊息永遠標 1，舊版 Client 才讀得懂)
+//   [2] 訊息種類
+//   [3..4] payload 長度 (uint16, little endian)
+//   [5..]  payload
+// 協商：Client 在 player_info 裡帶 "proto"，Server 在 start 裡回覆雙方都支援的版本，
+// 之後 game_state / attack / game_over 改用二進位封包，其餘維持 JSON 行。
+//
+// v2 起不再每次送整個盤面：平常只送差異 (方塊位置、鎖定的方塊與消行、HOLD/NEXT)，
+// 每 KEYFRAME_INTERVAL 次或對方要求時才送一次完整的 keyframe。
+// 每個差異都帶遞增的 seq，接收端發現缺號就送 MSG_KEYFRAME_REQUEST 重新同步。
+//
+// v3 加入 Server 權威模式：Client 只送輸入 (MSG_INPUT)，Server 用 TetrisEngine 重跑規則，
+// 自己決定消行與攻擊，用 MSG_GARBAGE 通知被攻擊的人，用 MSG_SYNC 校正玩家自己的盤面，
+// 對手畫面沿用 v2 的 keyframe / 差異。
+//
+// 觀戰：Client 送 {"type":"spectate","room":id} 訂閱某個房間，Server 把兩個玩家的畫面封包
+// 包成 MSG_SPECTATE ([0] 玩家 0/1 + 原本的整個封包) 轉給所有觀戰者，只有 Server 會送。
+//
+// v4 加入 MSG_PING / MSG_PONG：Client 與 Server 互相定期送，兩邊都用 ClockSync 估計來回時間、
+// 抖動與時鐘差。Server 在 start 裡帶 "server_proto"，Client 看到 >= 4 才開始送 PING。
+
+namespace Protocol {
+
+const uint8_t FRAME_MAGIC = 0xF5;
+const int PROTOCOL_VERSION = 4;
+const int HEADER_SIZE = 5;
+const int KEYFRAME_INTERVAL = 120;
+
+enum MessageType : uint8_t {
+    // v1
+    MSG_GAME_STATE = 1,
+    MSG_ATTACK = 2,
+    MSG_GAME_OVER = 3,
+    // v2
+    MSG_KEYFRAME = 4,
+    MSG_PIECE = 5,
+    MSG_PLACE = 6,
+    MSG_QUEUE = 7,
+    MSG_KEYFRAME_REQUEST = 8,
+    // v3
+    MSG_INPUT = 9,
+    MSG_GARBAGE = 10,
+    MSG_SYNC = 11,
+    MSG_SPECTATE = 12,
+    // v4
+    MSG_PING = 13,
+    MSG_PONG = 14
+};
+
+// MSG_GAME_OVER 的 payload (v1 的 Client 只看種類，不讀 payload)
+enum GameResult : uint8_t {
+    RESULT_OPPONENT_LOST = 0,
+    RESULT_YOU_LOST = 1
+};
+
+const int MAX_INPUT_BATCH = 32;
+
+// 盤面 (含正在落下的方塊)、HOLD 與 NEXT
+struct GameState
+{
+    TetrisBoard board;
+    int hold;
+    int nextCount;
+    int next[NEXT_QUEUE_SIZE];
+};
+
+// 完整同步：已鎖定的盤面 (不含落下中的方塊) + 落下中的方塊 + HOLD/NEXT
+struct Keyframe
+{
+    uint16_t seq;
+    TetrisBoard board;
+    TetrisPiece piece;
+    int hold;
+    int nextCount;
+    int next[NEXT_QUEUE_SIZE];
+};
+
+// 鎖定：方塊最後的位置 + 這次消掉的列 (bit y = 第 y 列)
+struct Placement
+{
+    uint16_t seq;
+    TetrisPiece piece;
+    uint32_t clearedRows;
+};
+
+struct QueueUpdate
+{
+    uint16_t seq;
+    int hold;
+    int nextCount;
+    int next[NEXT_QUEUE_SIZE];
+};
+
+// 權威模式：Server 處理完 ackInput 這個輸入之後，玩家自己的盤面應該長這樣
+struct Sync
+{
+    uint16_t ackInput;
+    TetrisBoard board;
+    TetrisPiece piece;
+    int hold;
+    bool canHold;
+};
+
+// 權威模式：Server 塞進來的垃圾行，ackInput 是當時已經處理到的最後一個輸入
+struct Garbage
+{
+    uint16_t ackInput;
+    int count;
+    int holes[GAME_ROWS];
+};
+
+// 時間都是送出端自己的單調時鐘 (微秒)：t0 = PING 送出，t1 = 對方收到，t2 = 對方回 PONG
+struct Pong
+{
+    uint16_t id;
+    int64_t t0;
+    int64_t t1;
+    int64_t t2;
+};
+
+struct FrameHeader
+{
+    int version;
+    int type;
+    int payloadSize;
+};
+
+// 最大的封包：1 + 20*2 (列遮罩) + 75 (每格 3 bits) + 2 + NEXT
+const int MAX_GAME_STATE_FRAME = HEADER_SIZE + 1 + GAME_ROWS * 2 + (GAME_ROWS * GAME_COLS * 3 + 7) / 8 + 2 + NEXT_QUEUE_SIZE;
+const int MAX_KEYFRAME_FRAME = MAX_GAME_STATE_FRAME + 2 + 4;
+const int MAX_DELTA_FRAME = HEADER_SIZE + 2 + 2 + NEXT_QUEUE_SIZE + 4;
+const int MAX_INPUT_FRAME = HEADER_SIZE + 3 + MAX_INPUT_BATCH;
+const int MAX_GARBAGE_FRAME = HEADER_SIZE + 3 + GAME_ROWS;
+const int MAX_SYNC_FRAME = MAX_GAME_STATE_FRAME + 2 + 4;
+const int MAX_SPECTATE_FRAME = HEADER_SIZE + 1 + MAX_KEYFRAME_FRAME;
+const int MAX_PING_FRAME = HEADER_SIZE + 2 + 8;
+const int MAX_PONG_FRAME = HEADER_SIZE + 2 + 8 * 3;
+
+// 以下 encode 都寫進呼叫端準備好的緩衝區，回傳整個封包長度
+int encodeGameState(const GameState &state, uint8_t *out);
+int encodeAttack(int lines, uint8_t *out);
+int encodeGameOver(uint8_t *out, int result = RESULT_OPPONENT_LOST);
+int encodeKeyframe(const Keyframe &keyframe, uint8_t *out);
+int encodePiece(uint16_t seq, const TetrisPiece &piece, uint8_t *out);
+int encodePlacement(const Placement &placement, uint8_t *out);
+int encodeQueue(const QueueUpdate &queue, uint8_t *out);
+int encodeKeyframeRequest(uint8_t *out);
+int encodeInputs(uint16_t firstSeq, const uint8_t *inputs, int count, uint8_t *out);
+int encodeGarbage(const Garbage &garbage, uint8_t *out);
+int encodeSync(const Sync &sync, uint8_t *out);
+// frame 是已經編好的整個封包 (含 header)
+int encodeSpectate(int slot, const uint8_t *frame, int frameSize, uint8_t *out);
+int encodePing(uint16_t id, int64_t t0, uint8_t *out);
+int encodePong(const Pong &pong, uint8_t *out);
+
+// data 至少要有 HEADER_SIZE 個位元組；magic 或版本不對回傳 false
+bool parseHeader(const uint8_t *data, FrameHeader &header);
+bool decodeGameState(const uint8_t *payload, int size, GameState &state);
+bool decodeAttack(const uint8_t *payload, int size, int &lines);
+bool decodeKeyframe(const uint8_t *payload, int size, Keyframe &keyframe);
+bool decodePiece(const uint8_t *payload, int size, uint16_t &seq, TetrisPiece &piece);
+bool decodePlacement(const uint8_t *payload, int size, Placement &placement);
+bool decodeQueue(const uint8_t *payload, int size, QueueUpdate &queue);
+int decodeGameOver(const uint8_t *payload, int size);
+// inputs 直接指向 payload 內部
+bool decodeInputs(const uint8_t *payload, int size, uint16_t &firstSeq, const uint8_t *&inputs, int &count);
+bool decodeGarbage(const uint8_t *payload, int size, Garbage &garbage);
+bool decodeSync(const uint8_t *payload, int size, Sync &sync);
+// frame 直接指向 payload 內部
+bool decodeSpectate(const uint8_t *payload, int size, int &slot, const uint8_t *&frame, int &frameSize);
+bool decodePing(const uint8_t *payload, int size, uint16_t &id, int64_t &t0);
+bool decodePong(const uint8_t *payload, int size, Pong &pong);
+
+// 把鎖定的方塊畫進盤面並移除消掉的列 (接收端重建對手盤面用)
+void applyPlacement(TetrisBoard &board, const Placement &placement);
+// 把落下中的方塊疊到盤面上 (只用來顯示)
+void stampPiece(TetrisBoard &board, const TetrisPiece &piece);
+
+} // namespace Protocol
+
+#endif // PROTOCOL_H
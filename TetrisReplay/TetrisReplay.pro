@@ -0,0 +1,11 @@
+# 重播檔的命令列工具：不畫圖，只用 TetrisEngine 重跑 (純 C++，不需要 Qt 函式庫)
+TEMPLATE = app
+TARGET = TetrisReplay
+
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+SOURCES += \
+        main.cpp
+
+include(../TetrisEngine/TetrisEngine.pri)
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "replay.h"
+
+// 用法：TetrisReplay [--realtime] [--seek FRAME] replay...
+// 每個檔案印一行結果，適合一次掃大量重播做分析；--realtime 照原本的速度播放
+static void printUsage()
+{
+    std::printf("Usage: TetrisReplay [--realtime] [--seek FRAME] replay...\n"
+                "  --realtime    play back at the recorded speed instead of as fast as possible\n"
+                "  --seek FRAME  jump to FRAME (uses snapshots) and report the state there\n");
+}
+
+static void playRealtime(Replay::Player &player)
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    while (!player.atEnd()) {
+        auto due = start + std::chrono::microseconds(uint64_t(player.nextFrame()) * 1000000 / Replay::FRAMES_PER_SECOND);
+        std::this_thread::sleep_until(due);
+        if (!player.step()) break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool realtime = false;
+    long seekFrame = -1;
+    int firstFile = argc;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if (std::strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+            seekFrame = std::strtol(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            printUsage();
+            return 0;
+        } else {
+            firstFile = i;
+            break;
+        }
+    }
+    if (firstFile >= argc) {
+        printUsage();
+        return 1;
+    }
+
+    int failed = 0;
+    std::printf("file,seed,inputs,frames,score,level,game_over,sim_us\n");
+    for (int i = firstFile; i < argc; ++i) {
+        Replay::Player player;
+        if (!player.load(argv[i])) {
+            std::fprintf(stderr, "%s: not a replay file\n", argv[i]);
+            failed++;
+            continue;
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        if (seekFrame >= 0) player.seek(uint32_t(seekFrame));
+        else if (realtime) playRealtime(player);
+        else player.runToEnd();
+        long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+
+        const TetrisEngine &engine = player.engine();
+        std::printf("%s,%u,%u,%u,%d,%d,%d,%lld\n", argv[i], player.seed(), player.inputCount(), player.frame(),
+                    engine.score(), engine.level(), engine.isGameOver() ? 1 : 0, us);
+    }
+    return failed > 0 ? 1 : 0;
+}
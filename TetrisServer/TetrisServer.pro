@@ -1,7 +1,7 @@
 QT -= gui
 QT += core network
 
-CONFIG += c++11 console
+CONFIG += c++17 console
 CONFIG -= app_bundle
 
 # The following define makes your compiler emit warnings if you use
@@ -12,7 +12,14 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += \
         main.cpp \
+        metrics.cpp \
+        roommanager.cpp \
         server.cpp
 
 HEADERS += \
+        metrics.h \
+        roommanager.h \
         server.h
+
+include(../TetrisEngine/TetrisEngine.pri)
+include(../TetrisProtocol/TetrisProtocol.pri)
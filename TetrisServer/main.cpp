@@ -1,11 +1,29 @@
 #include <QCoreApplication>
+#include <QCommandLineParser>
 #include "server.h"
 
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
 
-    Server server; // 啟動伺服器
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption workersOption("workers", "Number of room worker threads (default: CPU cores).", "count", "0");
+    QCommandLineOption portOption("port", "TCP port to listen on.", "port", "12345");
+    QCommandLineOption authoritativeOption("authoritative", "Run the game rules on the server for clients that support it (protocol v3).");
+    QCommandLineOption maxPendingOption("max-pending", "Disconnect clients with more than this many unsent KB.", "kb", "1024");
+    QCommandLineOption metricsPortOption("metrics-port", "Serve Prometheus metrics on 127.0.0.1:<port>/metrics (0 = off).", "port", "0");
+    parser.addOption(workersOption);
+    parser.addOption(portOption);
+    parser.addOption(authoritativeOption);
+    parser.addOption(maxPendingOption);
+    parser.addOption(metricsPortOption);
+    parser.process(a);
+
+    Server server(parser.value(workersOption).toInt(), parser.value(portOption).toUShort(),
+                  parser.isSet(authoritativeOption),
+                  parser.value(maxPendingOption).toLongLong() * 1024,
+                  parser.value(metricsPortOption).toUShort()); // 啟動伺服器
 
     return a.exec();
 }
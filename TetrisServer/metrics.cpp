@@ -0,0 +1,197 @@
+#include "metrics.h"
+#include "roommanager.h"
+#include "protocol.h"
+#include <QTcpSocket>
+
+const qint64 LatencyHistogram::BOUNDS_NS[LatencyHistogram::BUCKETS] = {
+    10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 25000000, 50000000
+};
+
+static const int MAX_REQUEST_SIZE = 8 * 1024;
+
+void LatencyHistogram::observe(qint64 ns)
+{
+    int bucket = 0;
+    while (bucket < BUCKETS && ns > BOUNDS_NS[bucket]) bucket++;
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    sumNs.fetch_add(quint64(qMax<qint64>(0, ns)), std::memory_order_relaxed);
+}
+
+const char *WorkerMetrics::typeName(int index)
+{
+    static const char *const NAMES[MESSAGE_TYPES] = {
+        "json", "game_state", "attack", "game_over", "keyframe", "piece", "place",
+        "queue", "keyframe_request", "input", "garbage", "sync", "spectate", "ping", "pong", "other"
+    };
+    return NAMES[index];
+}
+
+int WorkerMetrics::typeIndex(const char *data, int size)
+{
+    if (size < Protocol::HEADER_SIZE || uint8_t(data[0]) != Protocol::FRAME_MAGIC) return 0;
+    int type = uint8_t(data[2]);
+    return type > 0 && type < MESSAGE_TYPES - 1 ? type : MESSAGE_TYPES - 1;
+}
+
+void WorkerMetrics::countIn(const char *data, int size)
+{
+    int index = typeIndex(data, size);
+    messagesIn[index].fetch_add(1, std::memory_order_relaxed);
+    bytesIn[index].fetch_add(quint64(size), std::memory_order_relaxed);
+}
+
+void WorkerMetrics::countOut(const char *data, int size)
+{
+    int index = typeIndex(data, size);
+    messagesOut[index].fetch_add(1, std::memory_order_relaxed);
+    bytesOut[index].fetch_add(quint64(size), std::memory_order_relaxed);
+}
+
+MetricsServer::MetricsServer(const QVector<RoomManager*> &workers, QObject *parent)
+    : QTcpServer(parent), workers(workers)
+{
+    connect(this, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QTcpSocket *socket = nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            if (socket->state() != QAbstractSocket::ConnectedState) return;
+            // 只看第一行，標頭收完才回應
+            QByteArray request = socket->peek(MAX_REQUEST_SIZE);
+            if (!request.contains("\r\n\r\n") && !request.contains("\n\n") && request.size() < MAX_REQUEST_SIZE) return;
+
+            QList<QByteArray> line = request.left(request.indexOf('\n')).trimmed().split(' ');
+            QByteArray status = "200 OK";
+            QByteArray body;
+            if (line.size() < 2 || line[0] != "GET") {
+                status = "405 Method Not Allowed";
+            } else if (line[1] != "/metrics") {
+                status = "404 Not Found";
+            } else {
+                body = render();
+            }
+
+            QByteArray response = "HTTP/1.0 " + status + "\r\n"
+                                  "Content-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                                  "Connection: close\r\n\r\n" + body;
+            socket->readAll();
+            socket->write(response);
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+// --- Prometheus 文字格式 ---
+
+static void header(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += QByteArray("# HELP ") + name + " " + help + "\n";
+    out += QByteArray("# TYPE ") + name + " " + type + "\n";
+}
+
+static void sample(QByteArray &out, const char *name, const QByteArray &labels, double value)
+{
+    out += name;
+    if (!labels.isEmpty()) out += "{" + labels + "}";
+    out += " " + QByteArray::number(value, 'g', 12) + "\n";
+}
+
+static QByteArray workerLabel(int worker)
+{
+    return "worker=\"" + QByteArray::number(worker) + "\"";
+}
+
+static void histogram(QByteArray &out, const char *name, const QByteArray &labels, const LatencyHistogram &h)
+{
+    QByteArray bucketName = QByteArray(name) + "_bucket";
+    quint64 cumulative = 0;
+    for (int i = 0; i <= LatencyHistogram::BUCKETS; ++i) {
+        cumulative += h.counts[i].load(std::memory_order_relaxed);
+        QByteArray le = i < LatencyHistogram::BUCKETS ? QByteArray::number(LatencyHistogram::BOUNDS_NS[i] / 1e9, 'g', 6) : "+Inf";
+        sample(out, bucketName.constData(), labels + ",le=\"" + le + "\"", double(cumulative));
+    }
+    sample(out, (QByteArray(name) + "_sum").constData(), labels, h.sumNs.load(std::memory_order_relaxed) / 1e9);
+    sample(out, (QByteArray(name) + "_count").constData(), labels, double(cumulative));
+}
+
+QByteArray MetricsServer::render() const
+{
+    QByteArray out;
+
+    struct Gauge { const char *name; const char *help; std::atomic<int> WorkerMetrics::*field; };
+    const Gauge gauges[] = {
+        {"tetris_connections", "Open client connections (players and spectators).", &WorkerMetrics::connections},
+        {"tetris_rooms", "Active rooms.", &WorkerMetrics::rooms},
+        {"tetris_spectators", "Connections watching a room.", &WorkerMetrics::spectators},
+    };
+    for (const Gauge &gauge : gauges) {
+        header(out, gauge.name, "gauge", gauge.help);
+        for (int i = 0; i < workers.size(); ++i) {
+            sample(out, gauge.name, workerLabel(i), (workers[i]->metrics().*gauge.field).load(std::memory_order_relaxed));
+        }
+    }
+
+    struct Counter { const char *name; const char *help; std::atomic<quint64> (WorkerMetrics::*field)[WorkerMetrics::MESSAGE_TYPES]; };
+    const Counter counters[] = {
+        {"tetris_messages_received_total", "Messages received from clients.", &WorkerMetrics::messagesIn},
+        {"tetris_bytes_received_total", "Bytes received from clients.", &WorkerMetrics::bytesIn},
+        {"tetris_messages_sent_total", "Messages written to client sockets.", &WorkerMetrics::messagesOut},
+        {"tetris_bytes_sent_total", "Bytes written to client sockets.", &WorkerMetrics::bytesOut},
+    };
+    for (const Counter &counter : counters) {
+        header(out, counter.name, "counter", counter.help);
+        for (int i = 0; i < workers.size(); ++i) {
+            const std::atomic<quint64> *values = workers[i]->metrics().*counter.field;
+            for (int type = 0; type < WorkerMetrics::MESSAGE_TYPES; ++type) {
+                quint64 value = values[type].load(std::memory_order_relaxed);
+                if (value == 0) continue;
+                sample(out, counter.name, workerLabel(i) + ",type=\"" + WorkerMetrics::typeName(type) + "\"", double(value));
+            }
+        }
+    }
+
+    header(out, "tetris_view_frames_dropped_total", "counter", "View frames dropped because the receiver was over its outbound budget.");
+    for (int i = 0; i < workers.size(); ++i) {
+        sample(out, "tetris_view_frames_dropped_total", workerLabel(i), workers[i]->metrics().viewFramesDropped.load(std::memory_order_relaxed));
+    }
+    header(out, "tetris_slow_disconnects_total", "counter", "Connections closed for exceeding the pending byte limit.");
+    for (int i = 0; i < workers.size(); ++i) {
+        sample(out, "tetris_slow_disconnects_total", workerLabel(i), workers[i]->metrics().slowDisconnects.load(std::memory_order_relaxed));
+    }
+
+    header(out, "tetris_outbound_queued_bytes", "gauge", "Sum of bytes waiting in client socket write buffers.");
+    for (int i = 0; i < workers.size(); ++i) {
+        sample(out, "tetris_outbound_queued_bytes", workerLabel(i), workers[i]->metrics().queuedBytes.load(std::memory_order_relaxed));
+    }
+    header(out, "tetris_outbound_queued_bytes_max", "gauge", "Largest write buffer of a single connection.");
+    for (int i = 0; i < workers.size(); ++i) {
+        sample(out, "tetris_outbound_queued_bytes_max", workerLabel(i), workers[i]->metrics().maxQueuedBytes.load(std::memory_order_relaxed));
+    }
+    header(out, "tetris_event_loop_lag_last_seconds", "gauge", "Most recent event loop lag sample.");
+    for (int i = 0; i < workers.size(); ++i) {
+        sample(out, "tetris_event_loop_lag_last_seconds", workerLabel(i), workers[i]->metrics().loopLagNs.load(std::memory_order_relaxed) / 1e9);
+    }
+
+    header(out, "tetris_client_rtt_avg_seconds", "gauge", "Mean smoothed round-trip time of connections answering pings.");
+    for (int i = 0; i < workers.size(); ++i) {
+        sample(out, "tetris_client_rtt_avg_seconds", workerLabel(i), workers[i]->metrics().clientRttAvgNs.load(std::memory_order_relaxed) / 1e9);
+    }
+    header(out, "tetris_client_jitter_avg_seconds", "gauge", "Mean round-trip jitter of connections answering pings.");
+    for (int i = 0; i < workers.size(); ++i) {
+        sample(out, "tetris_client_jitter_avg_seconds", workerLabel(i), workers[i]->metrics().clientJitterAvgNs.load(std::memory_order_relaxed) / 1e9);
+    }
+
+    header(out, "tetris_relay_latency_seconds", "histogram", "Time from reading a message off the socket to queuing its forwards.");
+    for (int i = 0; i < workers.size(); ++i) histogram(out, "tetris_relay_latency_seconds", workerLabel(i), workers[i]->metrics().relayLatency);
+    header(out, "tetris_event_loop_lag_seconds", "histogram", "How late the worker's periodic probe timer fired.");
+    for (int i = 0; i < workers.size(); ++i) histogram(out, "tetris_event_loop_lag_seconds", workerLabel(i), workers[i]->metrics().loopLag);
+    header(out, "tetris_client_rtt_seconds", "histogram", "Round-trip time of each ping/pong with v4 clients.");
+    for (int i = 0; i < workers.size(); ++i) histogram(out, "tetris_client_rtt_seconds", workerLabel(i), workers[i]->metrics().clientRtt);
+
+    return out;
+}
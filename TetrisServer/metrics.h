@@ -0,0 +1,75 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QTcpServer>
+#include <QVector>
+#include <atomic>
+
+// 執行期統計：每個 worker 一份，只有自己的 thread 會寫 (relaxed atomic，不用鎖)，
+// MetricsServer 在主執行緒讀出來，用 Prometheus 文字格式給 GET /metrics。
+
+// 固定邊界的延遲分佈 (奈秒)，輸出時再轉成秒與累積數量
+struct LatencyHistogram
+{
+    static const int BUCKETS = 12;
+    static const qint64 BOUNDS_NS[BUCKETS];
+
+    std::atomic<quint64> counts[BUCKETS + 1] = {};  // 最後一格是 +Inf
+    std::atomic<quint64> sumNs{0};
+
+    void observe(qint64 ns);
+};
+
+struct WorkerMetrics
+{
+    // 0 = JSON 行，1~14 = Protocol::MessageType，最後一格是認不得的種類
+    static const int MESSAGE_TYPES = 16;
+    static const char *typeName(int index);
+    static int typeIndex(const char *data, int size);   // 從封包開頭判斷種類
+
+    std::atomic<quint64> messagesIn[MESSAGE_TYPES] = {};
+    std::atomic<quint64> bytesIn[MESSAGE_TYPES] = {};
+    std::atomic<quint64> messagesOut[MESSAGE_TYPES] = {};
+    std::atomic<quint64> bytesOut[MESSAGE_TYPES] = {};
+
+    std::atomic<quint64> viewFramesDropped{0};    // 塞車丟掉的畫面封包
+    std::atomic<quint64> slowDisconnects{0};      // 超過 --max-pending 被斷線
+
+    // 由 worker 定期取樣的即時數值
+    std::atomic<int> connections{0};
+    std::atomic<int> rooms{0};
+    std::atomic<int> spectators{0};
+    std::atomic<qint64> queuedBytes{0};           // 所有連線的 bytesToWrite() 總和
+    std::atomic<qint64> maxQueuedBytes{0};        // 最大的一條
+    std::atomic<qint64> loopLagNs{0};             // 最近一次事件迴圈延遲
+    std::atomic<qint64> clientRttAvgNs{0};        // 各連線平滑後來回時間的平均 (v4 PING)
+    std::atomic<qint64> clientJitterAvgNs{0};
+
+    LatencyHistogram relayLatency;                // 讀進來到轉送出去 (寫進對方的 socket)
+    LatencyHistogram loopLag;
+    LatencyHistogram clientRtt;                   // 每個 PONG 量到的來回時間
+
+    void countIn(const char *data, int size);
+    void countOut(const char *data, int size);
+};
+
+class RoomManager;
+
+// 只聽 localhost：回一次 HTTP/1.0 回應就關掉連線
+class MetricsServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    MetricsServer(const QVector<RoomManager*> &workers, QObject *parent = nullptr);
+
+    QByteArray render() const;
+
+private slots:
+    void onNewConnection();
+
+private:
+    QVector<RoomManager*> workers;
+};
+
+#endif // METRICS_H
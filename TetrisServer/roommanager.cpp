@@ -0,0 +1,853 @@
+#include "roommanager.h"
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QThread>
+
+const int VIEW_NEXT_COUNT = 3; // 跟 Client 一樣，對手畫面只顯示 3 個 NEXT
+const qint64 VIEW_BUDGET = 64 * 1024; // 還沒送出的資料超過這個量就開始丟畫面差異
+const int METRICS_PROBE_MS = 100;     // 事件迴圈延遲與佇列深度的取樣間隔
+const int PING_EVERY_PROBES = 10;     // 每秒對房間裡的 v4 連線送一次 PING
+
+static QByteArray jsonLine(const QJsonObject &root)
+{
+    // 使用 Compact 模式，確保 JSON 是一整行，不會被換行符號切斷
+    return QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n";
+}
+
+// 包成 MSG_SPECTATE；回傳的 QByteArray 直接寫給每個觀戰者，write(QByteArray) 只會共用同一份資料
+static QByteArray spectateFrame(int slot, const uint8_t *frame, int size)
+{
+    QByteArray out(Protocol::HEADER_SIZE + 1 + size, Qt::Uninitialized);
+    Protocol::encodeSpectate(slot, frame, size, reinterpret_cast<uint8_t*>(out.data()));
+    return out;
+}
+
+static QByteArray spectateKeyframe(int slot, const Protocol::Keyframe &keyframe)
+{
+    uint8_t frame[Protocol::MAX_KEYFRAME_FRAME];
+    return spectateFrame(slot, frame, Protocol::encodeKeyframe(keyframe, frame));
+}
+
+RoomManager::RoomManager(int workerId, int workerCount, bool authoritative, qint64 maxPending, QObject *parent)
+    : QObject(parent), workerId(workerId), workerCount(qMax(1, workerCount)), authoritative(authoritative)
+    , maxPending(qMax(maxPending, 2 * VIEW_BUDGET))
+    , lobby(nullptr), nextRoomId(1), activeRooms(0), probeTimer(nullptr), nextProbeNs(0), probeCount(0)
+{
+    clock.start();
+}
+
+RoomManager::~RoomManager()
+{
+    for (Connection *conn : connections) {
+        if (conn->room && conn->room->players[0] == conn) delete conn->room;
+        delete conn;
+    }
+}
+
+void RoomManager::addConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qDebug() << "Worker" << workerId << "failed to adopt socket:" << socket->errorString();
+        delete socket;
+        return;
+    }
+
+    attach(socket);
+    qDebug() << "Worker" << workerId << "client connected. Total:" << connections.size();
+}
+
+RoomManager::Connection *RoomManager::attach(QTcpSocket *socket)
+{
+    Connection *conn = new Connection;
+    conn->socket = socket;
+    connections.insert(socket, conn);
+
+    connect(socket, &QTcpSocket::readyRead, this, &RoomManager::onReadyRead);
+    connect(socket, &QTcpSocket::disconnected, this, &RoomManager::onDisconnected);
+    return conn;
+}
+
+// socket 只能由目前的 thread 移走；還沒讀的資料留在 socket 裡，轉交之後對方本來就會先等 Server 回話
+QTcpSocket *RoomManager::detach(Connection *conn, RoomManager *target)
+{
+    QTcpSocket *socket = conn->socket;
+    connections.remove(socket);
+    disconnect(socket, nullptr, this, nullptr);
+    socket->setParent(nullptr);
+    socket->moveToThread(target->thread());
+    delete conn;
+    return socket;
+}
+
+void RoomManager::adoptSpectator(QTcpSocket *socket, int roomId, int proto)
+{
+    socket->setParent(this);
+    if (socket->state() != QAbstractSocket::ConnectedState) {
+        socket->deleteLater(); // 轉交途中就斷線了
+        return;
+    }
+
+    Connection *conn = attach(socket);
+    QJsonObject request;
+    request["room"] = roomId;
+    request["proto"] = proto;
+    spectate(conn, request);
+    socket->flush();
+}
+
+void RoomManager::onReadyRead()
+{
+    QTcpSocket *senderSocket = qobject_cast<QTcpSocket*>(sender());
+    Connection *conn = connections.value(senderSocket);
+    if (!conn) return;
+
+    // 依訊息邊界處理：沒收完的訊息留在 decoder 裡，不會把半個封包丟給對手
+    FrameDecoder &decoder = conn->decoder;
+    for (;;) {
+        int space = decoder.writableSize();
+        if (space > 0 && senderSocket->bytesAvailable() > 0) {
+            qint64 n = senderSocket->read(reinterpret_cast<char*>(decoder.writePointer()), space);
+            if (n > 0) decoder.commit(int(n));
+        }
+
+        qint64 readAt = clock.nsecsElapsed();
+        FrameDecoder::Message msg;
+        FrameDecoder::Result result;
+        while ((result = decoder.next(msg)) == FrameDecoder::MessageReady) {
+            stats.countIn(reinterpret_cast<const char*>(msg.frame), msg.frameSize);
+            bool relayed = conn->room != nullptr;
+            handleMessage(conn, msg);
+            if (connections.value(senderSocket) != conn) return; // 觀戰者或配對的玩家已經交給別的 worker
+            if (relayed) stats.relayLatency.observe(clock.nsecsElapsed() - readAt);
+        }
+
+        if (result == FrameDecoder::Malformed) {
+            qDebug() << "Malformed stream, dropping client";
+            senderSocket->disconnectFromHost();
+            return;
+        }
+        if (senderSocket->bytesAvailable() <= 0) break;
+    }
+
+    // 權威模式下自己也會收到 SYNC / 垃圾行，一起送出
+    Connection *peer = peerOf(conn);
+    if (peer && peer->socket->state() == QAbstractSocket::ConnectedState) peer->socket->flush();
+    if (senderSocket->state() == QAbstractSocket::ConnectedState) senderSocket->flush();
+    if (conn->room) {
+        for (Connection *spectator : conn->room->spectators) {
+            if (spectator->socket->state() == QAbstractSocket::ConnectedState) spectator->socket->flush();
+        }
+    }
+}
+
+void RoomManager::handleMessage(Connection *conn, const FrameDecoder::Message &msg)
+{
+    // PING / PONG 只在 Client 與 Server 之間，不轉給任何人
+    if (msg.binary && (msg.type == Protocol::MSG_PING || msg.type == Protocol::MSG_PONG)) {
+        handlePing(conn, msg);
+        return;
+    }
+
+    if (!conn->room) {
+        // 配對前只會有 JSON 行，從 player_info 讀出名字與 Client 支援的協定版本
+        if (msg.binary || conn->hasInfo || conn->watching) return;
+        QByteArray line = QByteArray::fromRawData(reinterpret_cast<const char*>(msg.payload), msg.payloadSize);
+        QJsonObject root = QJsonDocument::fromJson(line).object();
+        if (root["type"].toString() == "spectate") {
+            spectate(conn, root);
+            return;
+        }
+        if (root["type"].toString() != "player_info") return;
+
+        conn->hasInfo = true;
+        conn->proto = root["proto"].toInt(0);
+        conn->playerInfo = QByteArray(reinterpret_cast<const char*>(msg.frame), msg.frameSize);
+        matchPlayer(conn);
+        return;
+    }
+
+    if (conn->room->authoritative) {
+        handleAuthoritative(conn, msg);
+        return;
+    }
+
+    // 只轉給同房間的對手；畫面封包走流量控制 (觀戰者也一起)，其餘一定送
+    Connection *peer = peerOf(conn);
+    if (msg.binary) {
+        switch (msg.type) {
+        case Protocol::MSG_GAME_STATE:
+        case Protocol::MSG_KEYFRAME:
+        case Protocol::MSG_PIECE:
+        case Protocol::MSG_PLACE:
+        case Protocol::MSG_QUEUE:
+        case Protocol::MSG_GAME_OVER:
+            publishView(conn->room, conn->room->players[0] == conn ? 0 : 1, msg.frame, msg.frameSize, peer);
+            return;
+        default:
+            writeTo(peer, msg.frame, msg.frameSize);
+            return;
+        }
+    }
+
+    // 只懂 JSON 的 Client：game_state 每次都是完整盤面，塞車時丟掉也不會少東西
+    if (!canWrite(peer)) return;
+    if (peer->socket->bytesToWrite() > VIEW_BUDGET) {
+        QByteArray line = QByteArray::fromRawData(reinterpret_cast<const char*>(msg.payload), msg.payloadSize);
+        if (QJsonDocument::fromJson(line).object()["type"].toString() == "game_state") return;
+    }
+    writeTo(peer, msg.frame, msg.frameSize);
+}
+
+void RoomManager::adoptPlayer(QTcpSocket *socket, const QByteArray &playerInfo, int proto, quint64 ticket)
+{
+    socket->setParent(this);
+    Connection *first = waiting.take(ticket);
+    if (socket->state() != QAbstractSocket::ConnectedState) {
+        // 轉交途中就斷線了：Lobby 的位子已經被拿走，等待者重新登記
+        socket->deleteLater();
+        if (first) matchPlayer(first);
+        return;
+    }
+
+    Connection *conn = attach(socket);
+    conn->hasInfo = true;
+    conn->proto = proto;
+    conn->playerInfo = playerInfo;
+    if (!first) {
+        matchPlayer(conn); // 等待者在轉交途中斷線了，換這個玩家排隊
+        return;
+    }
+    pairPlayers(first, conn);
+    first->socket->flush();
+    socket->flush();
+}
+
+// 在 Lobby 決定配對：位子空著就登記；等待者在這個 worker 就直接開房間，否則把自己交過去
+void RoomManager::matchPlayer(Connection *conn)
+{
+    RoomManager *owner;
+    quint64 ticket;
+    {
+        QMutexLocker locker(&lobby->lock);
+        owner = lobby->worker;
+        ticket = lobby->ticket;
+        if (owner) {
+            lobby->worker = nullptr;
+        } else {
+            lobby->worker = this;
+            lobby->ticket = conn->ticket = lobby->nextTicket++;
+        }
+    }
+
+    if (!owner) {
+        waiting.insert(conn->ticket, conn);
+        return;
+    }
+    if (owner == this) {
+        Connection *first = waiting.take(ticket);
+        if (first) pairPlayers(first, conn);
+        else matchPlayer(conn);
+        return;
+    }
+
+    QByteArray playerInfo = conn->playerInfo;
+    int proto = conn->proto;
+    QTcpSocket *socket = detach(conn, owner);
+    QMetaObject::invokeMethod(owner, [owner, socket, playerInfo, proto, ticket]() {
+        owner->adoptPlayer(socket, playerInfo, proto, ticket);
+    }, Qt::QueuedConnection);
+}
+
+// 等待者斷線：位子還是自己的才清掉 (已經被別的 worker 拿走的話，轉交過來時會發現人不在)
+void RoomManager::leaveLobby(Connection *conn)
+{
+    if (!conn->ticket || !waiting.remove(conn->ticket)) return;
+    QMutexLocker locker(&lobby->lock);
+    if (lobby->worker == this && lobby->ticket == conn->ticket) lobby->worker = nullptr;
+}
+
+void RoomManager::pairPlayers(Connection *first, Connection *second)
+{
+    Room *room = new Room;
+    room->id = nextRoomId++ * workerCount + workerId; // 餘數 = worker 編號，觀戰者才找得到房間
+    room->players[0] = first;
+    room->players[1] = second;
+    room->authoritative = false;
+    room->proto = 0;
+    room->viewValid[0] = room->viewValid[1] = false;
+    first->room = room;
+    second->room = room;
+    rooms.insert(room->id, room);
+    activeRooms++;
+
+    startRoom(room);
+}
+
+void RoomManager::startRoom(Room *room)
+{
+    // 兩邊都支援的協定版本
+    int proto = qMin(Protocol::PROTOCOL_VERSION, qMin(room->players[0]->proto, room->players[1]->proto));
+    room->proto = proto;
+    room->authoritative = authoritative && proto >= 3;
+    qDebug() << "Worker" << workerId << "match found! Room" << room->id << "proto =" << proto
+             << (room->authoritative ? "(authoritative)" : "") << "active rooms:" << activeRooms;
+
+    // 每場由 Server 決定種子，兩邊的方塊順序一樣，整場也能用種子 + 輸入重現
+    room->seed = QRandomGenerator::global()->generate();
+
+    QJsonObject root;
+    root["type"] = "start";
+    root["room"] = room->id;
+    root["proto"] = proto;
+    root["server_proto"] = Protocol::PROTOCOL_VERSION; // PING 只看 Server 自己支援的版本
+    root["seed"] = double(room->seed);
+    if (room->authoritative) {
+        root["mode"] = "authoritative";
+        for (Connection *player : room->players) {
+            player->engine.reset(room->seed);
+            player->nextInput = 0;
+            player->viewSeq = 0;
+            player->viewUpdates = 0;
+            player->viewKeyframePending = true;
+        }
+    }
+    QByteArray start = jsonLine(root);
+
+    for (int i = 0; i < 2; ++i) {
+        if (!canWrite(room->players[i])) continue;
+        send(room->players[i], room->players[1 - i]->playerInfo); // 先告訴對方名字
+        send(room->players[i], start);
+    }
+
+    if (room->authoritative) {
+        sendView(room->players[0]);
+        sendView(room->players[1]);
+    }
+    for (Connection *player : room->players) {
+        if (player->socket->state() == QAbstractSocket::ConnectedState) player->socket->flush(); // 確保立即送出
+    }
+}
+
+// --- 權威模式 ---
+
+void RoomManager::handleAuthoritative(Connection *conn, const FrameDecoder::Message &msg)
+{
+    // Client 自己送的盤面、攻擊、game_over 一律不信，只收輸入與 keyframe 請求
+    if (!msg.binary) return;
+
+    switch (msg.type) {
+    case Protocol::MSG_INPUT: {
+        uint16_t firstSeq;
+        const uint8_t *inputs;
+        int count;
+        if (Protocol::decodeInputs(msg.payload, msg.payloadSize, firstSeq, inputs, count)) {
+            applyInputs(conn, firstSeq, inputs, count);
+        }
+        break;
+    }
+    case Protocol::MSG_KEYFRAME_REQUEST: {
+        Connection *peer = peerOf(conn);
+        if (peer) sendViewKeyframe(peer, conn);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void RoomManager::applyInputs(Connection *conn, uint16_t firstSeq, const uint8_t *inputs, int count)
+{
+    // TCP 不會亂序，這裡只略過已經處理過的部分 (序號是 16-bit 迴繞)
+    int skip = uint16_t(conn->nextInput - firstSeq);
+    if (skip >= count) return;
+
+    bool locked = false;
+    for (int i = skip; i < count; ++i) {
+        conn->nextInput++;
+        LockResult result;
+        if (!conn->engine.applyInput(static_cast<TetrisInput>(inputs[i]), result)) {
+            // HOLD 換進來的方塊放不下也會輸，這時沒有鎖定結果
+            if (conn->engine.isGameOver()) {
+                sendSync(conn);
+                finishRoom(conn->room, conn);
+                return;
+            }
+            continue;
+        }
+
+        locked = true;
+        Connection *peer = peerOf(conn);
+        if (peer && !conn->viewKeyframePending) {
+            Protocol::Placement placement;
+            placement.seq = conn->viewSeq++;
+            placement.piece = result.placed;
+            placement.clearedRows = result.clearedRows;
+            uint8_t frame[Protocol::MAX_DELTA_FRAME];
+            sendViewFrame(conn, peer, frame, Protocol::encodePlacement(placement, frame));
+            conn->viewUpdates++;
+            conn->viewPiece.shape = 0; // 新方塊一定要再送一次
+        }
+
+        if (result.attack > 0) sendGarbage(conn, result.attack);
+        if (result.toppedOut) {
+            sendSync(conn);
+            finishRoom(conn->room, conn);
+            return;
+        }
+    }
+
+    if (locked) sendSync(conn);
+    sendView(conn);
+}
+
+void RoomManager::sendGarbage(Connection *attacker, int lines)
+{
+    Connection *victim = peerOf(attacker);
+    if (!victim) return;
+
+    Protocol::Garbage garbage;
+    garbage.ackInput = uint16_t(victim->nextInput - 1);
+    // 洞從被攻擊方自己的垃圾行串流抽，跟非權威模式的 Client 用的是同一套規則
+    garbage.count = victim->engine.peekGarbageHoles(lines, garbage.holes);
+    victim->engine.addGarbageLines(garbage.count, garbage.holes);
+
+    uint8_t frame[Protocol::MAX_GARBAGE_FRAME];
+    writeTo(victim, frame, Protocol::encodeGarbage(garbage, frame));
+
+    // 被攻擊方的盤面整個往上推，直接給攻擊方一個 keyframe
+    victim->viewKeyframePending = true;
+    sendView(victim);
+}
+
+void RoomManager::sendSync(Connection *conn)
+{
+    Protocol::Sync sync;
+    sync.ackInput = uint16_t(conn->nextInput - 1);
+    sync.board = conn->engine.board();
+    sync.piece = conn->engine.piece();
+    sync.hold = conn->engine.heldShape();
+    sync.canHold = conn->engine.canHold();
+
+    uint8_t frame[Protocol::MAX_SYNC_FRAME];
+    writeTo(conn, frame, Protocol::encodeSync(sync, frame));
+}
+
+// subject 的畫面變化送給對手，做法跟 Client 的 sendStateDelta 一樣
+void RoomManager::sendView(Connection *subject)
+{
+    Connection *viewer = peerOf(subject);
+    if (!viewer) return;
+
+    if (subject->viewKeyframePending || subject->viewUpdates >= Protocol::KEYFRAME_INTERVAL) {
+        sendViewKeyframe(subject, viewer);
+        return;
+    }
+
+    const TetrisEngine &engine = subject->engine;
+    uint8_t frame[Protocol::MAX_DELTA_FRAME];
+
+    bool queueChanged = engine.heldShape() != subject->viewHold;
+    for (int i = 0; i < VIEW_NEXT_COUNT; ++i) queueChanged |= engine.nextPiece(i) != subject->viewNext[i];
+    if (queueChanged) {
+        Protocol::QueueUpdate queue;
+        queue.seq = subject->viewSeq++;
+        queue.hold = subject->viewHold = engine.heldShape();
+        queue.nextCount = VIEW_NEXT_COUNT;
+        for (int i = 0; i < VIEW_NEXT_COUNT; ++i) queue.next[i] = subject->viewNext[i] = engine.nextPiece(i);
+        sendViewFrame(subject, viewer, frame, Protocol::encodeQueue(queue, frame));
+        subject->viewUpdates++;
+    }
+
+    const TetrisPiece &piece = engine.piece();
+    const TetrisPiece &last = subject->viewPiece;
+    if (piece.shape != last.shape || piece.rotation != last.rotation || piece.x != last.x || piece.y != last.y) {
+        subject->viewPiece = piece;
+        sendViewFrame(subject, viewer, frame, Protocol::encodePiece(subject->viewSeq++, piece, frame));
+        subject->viewUpdates++;
+    }
+}
+
+void RoomManager::sendViewKeyframe(Connection *subject, Connection *viewer)
+{
+    const TetrisEngine &engine = subject->engine;
+    Protocol::Keyframe keyframe;
+    keyframe.seq = subject->viewSeq++;
+    keyframe.board = engine.board();
+    keyframe.piece = subject->viewPiece = engine.piece();
+    keyframe.hold = subject->viewHold = engine.heldShape();
+    keyframe.nextCount = VIEW_NEXT_COUNT;
+    for (int i = 0; i < VIEW_NEXT_COUNT; ++i) keyframe.next[i] = subject->viewNext[i] = engine.nextPiece(i);
+
+    uint8_t frame[Protocol::MAX_KEYFRAME_FRAME];
+    sendViewFrame(subject, viewer, frame, Protocol::encodeKeyframe(keyframe, frame));
+    subject->viewKeyframePending = false;
+    subject->viewUpdates = 0;
+}
+
+// 對手看到的畫面，觀戰者也看到同一份 (seq 連續，觀戰者的 Client 可以用同一套差異邏輯)
+void RoomManager::sendViewFrame(Connection *subject, Connection *viewer, const uint8_t *frame, int size)
+{
+    publishView(subject->room, subject->room->players[0] == subject ? 0 : 1, frame, size, viewer);
+}
+
+// Server 判定 loser 輸了：兩邊各自收到結果，房間解散
+void RoomManager::finishRoom(Room *room, Connection *loser)
+{
+    Connection *winner = room->players[0] == loser ? room->players[1] : room->players[0];
+    uint8_t frame[Protocol::HEADER_SIZE + 1];
+    writeTo(loser, frame, Protocol::encodeGameOver(frame, Protocol::RESULT_YOU_LOST));
+    writeTo(winner, frame, Protocol::encodeGameOver(frame, Protocol::RESULT_OPPONENT_LOST));
+    endSpectators(room, room->players[0] == loser ? 0 : 1);
+
+    winner->room = nullptr;
+    loser->room = nullptr;
+    rooms.remove(room->id);
+    activeRooms--;
+    qDebug() << "Worker" << workerId << "room" << room->id << "finished. Active rooms:" << activeRooms;
+    delete room;
+}
+
+void RoomManager::closeRoom(Room *room, Connection *leaver)
+{
+    Connection *peer = room->players[0] == leaver ? room->players[1] : room->players[0];
+    endSpectators(room, room->players[0] == leaver ? 0 : 1);
+    peer->room = nullptr;
+    leaver->room = nullptr;
+    rooms.remove(room->id);
+    activeRooms--;
+
+    // 通知還在的人遊戲結束
+    if (canWrite(peer)) {
+        QJsonObject root;
+        root["type"] = "game_over";
+        send(peer, jsonLine(root));
+        peer->socket->flush();
+    }
+
+    qDebug() << "Worker" << workerId << "room" << room->id << "closed. Active rooms:" << activeRooms;
+    delete room;
+}
+
+// --- 觀戰 ---
+
+void RoomManager::spectate(Connection *conn, const QJsonObject &request)
+{
+    // 沒指定房間就看這個 worker 上任何一場
+    int roomId = request["room"].toInt(-1);
+    conn->proto = request["proto"].toInt(0);
+    int owner = roomId >= 0 ? roomId % workerCount : workerId;
+    if (owner != workerId && owner < workers.size()) {
+        RoomManager *target = workers[owner];
+        int proto = conn->proto;
+        QTcpSocket *socket = detach(conn, target);
+        QMetaObject::invokeMethod(target, [target, socket, roomId, proto]() {
+            target->adoptSpectator(socket, roomId, proto);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // 只懂 JSON 的房間 (proto 0) 不看：畫面只會走 JSON 行直接轉給對手，沒有可以轉給觀戰者的封包
+    Room *room = rooms.value(roomId);
+    if (roomId < 0) {
+        for (Room *candidate : rooms) {
+            if (candidate->proto >= 1) { room = candidate; break; }
+        }
+    }
+    if (!room || room->proto < 1) {
+        QJsonObject root;
+        root["type"] = "spectate_error";
+        root["room"] = roomId;
+        root["reason"] = room ? "unsupported" : "not_found";
+        if (canWrite(conn)) send(conn, jsonLine(root));
+        return;
+    }
+    watchRoom(conn, room);
+}
+
+void RoomManager::watchRoom(Connection *conn, Room *room)
+{
+    conn->watching = room;
+    room->spectators.append(conn);
+    if (!canWrite(conn)) return;
+
+    send(conn, room->players[0]->playerInfo);
+    send(conn, room->players[1]->playerInfo);
+
+    QJsonObject root;
+    root["type"] = "spectate_start";
+    root["room"] = room->id;
+    root["proto"] = room->proto;
+    root["server_proto"] = Protocol::PROTOCOL_VERSION;
+    root["seed"] = double(room->seed);
+    if (room->authoritative) root["mode"] = "authoritative";
+    send(conn, jsonLine(root));
+
+    // 中途加入：有重建好的畫面就先補一個 keyframe，否則等下一個 keyframe
+    for (int slot = 0; slot < 2; ++slot) {
+        conn->behind[slot] = !room->viewValid[slot];
+        if (room->viewValid[slot]) send(conn, spectateKeyframe(slot, room->views[slot]));
+    }
+    qDebug() << "Worker" << workerId << "room" << room->id << "spectators:" << room->spectators.size();
+}
+
+// slot 這個玩家的畫面封包：更新 Server 這邊的畫面，再轉給對手 (viewer) 與所有觀戰者
+void RoomManager::publishView(Room *room, int slot, const uint8_t *frame, int size, Connection *viewer)
+{
+    Protocol::FrameHeader header;
+    if (size < Protocol::HEADER_SIZE || !Protocol::parseHeader(frame, header)) return;
+    const uint8_t *payload = frame + Protocol::HEADER_SIZE;
+    int payloadSize = size - Protocol::HEADER_SIZE;
+
+    Protocol::Keyframe &view = room->views[slot];
+    bool delta = false;
+    switch (header.type) {
+    case Protocol::MSG_GAME_STATE:  // v1 每次都是完整盤面，不用重建
+    case Protocol::MSG_GAME_OVER:
+        break;
+    case Protocol::MSG_KEYFRAME:
+        if (!Protocol::decodeKeyframe(payload, payloadSize, view)) return;
+        room->viewValid[slot] = true;
+        break;
+    case Protocol::MSG_PIECE:
+        if (!Protocol::decodePiece(payload, payloadSize, view.seq, view.piece)) return;
+        delta = true;
+        break;
+    case Protocol::MSG_PLACE: {
+        Protocol::Placement placement;
+        if (!Protocol::decodePlacement(payload, payloadSize, placement)) return;
+        Protocol::applyPlacement(view.board, placement);
+        view.piece.shape = 0;
+        view.seq = placement.seq;
+        delta = true;
+        break;
+    }
+    case Protocol::MSG_QUEUE: {
+        Protocol::QueueUpdate queue;
+        if (!Protocol::decodeQueue(payload, payloadSize, queue)) return;
+        view.seq = queue.seq;
+        view.hold = queue.hold;
+        view.nextCount = queue.nextCount;
+        for (int i = 0; i < queue.nextCount; i++) view.next[i] = queue.next[i];
+        delta = true;
+        break;
+    }
+    default:
+        return;
+    }
+
+    if (viewer) {
+        switch (viewAction(viewer, slot, header.type, delta, room->viewValid[slot])) {
+        case VIEW_FRAME:
+            send(viewer, reinterpret_cast<const char*>(frame), size);
+            break;
+        case VIEW_KEYFRAME: {
+            uint8_t keyframe[Protocol::MAX_KEYFRAME_FRAME];
+            send(viewer, reinterpret_cast<const char*>(keyframe), Protocol::encodeKeyframe(view, keyframe));
+            break;
+        }
+        case VIEW_SKIP:
+            break;
+        }
+    }
+
+    // 觀戰者：兩種封包都只在第一次用到時編一次，之後每個觀戰者共用
+    QByteArray shared;
+    QByteArray catchUp;
+    for (Connection *spectator : room->spectators) {
+        switch (viewAction(spectator, slot, header.type, delta, room->viewValid[slot])) {
+        case VIEW_FRAME:
+            if (shared.isEmpty()) shared = spectateFrame(slot, frame, size);
+            send(spectator, shared);
+            break;
+        case VIEW_KEYFRAME:
+            if (catchUp.isEmpty()) catchUp = spectateKeyframe(slot, view);
+            send(spectator, catchUp);
+            break;
+        case VIEW_SKIP:
+            break;
+        }
+    }
+}
+
+// to 這條連線要怎麼處理 slot 的畫面封包：塞車就丟，消化完之後的第一個差異換成 keyframe
+RoomManager::ViewAction RoomManager::viewAction(Connection *to, int slot, int type, bool delta, bool viewValid)
+{
+    if (!canWrite(to)) return VIEW_SKIP;
+    if (type == Protocol::MSG_GAME_OVER) return VIEW_FRAME;
+
+    bool &behind = to->behind[slot];
+    if (to->socket->bytesToWrite() > VIEW_BUDGET) {
+        behind = true;
+        stats.viewFramesDropped.fetch_add(1, std::memory_order_relaxed);
+        return VIEW_SKIP;
+    }
+    if (behind && delta) {
+        // 用套用這個差異之後的畫面當 keyframe，seq 相同，接下來的差異可以直接接上
+        if (!viewValid) return VIEW_SKIP;
+        behind = false;
+        return VIEW_KEYFRAME;
+    }
+    if (!delta) behind = false;
+    return VIEW_FRAME;
+}
+
+// 房間結束：通知觀戰者誰輸了 (斷線的一方也算輸)，觀戰者留著連線，可以再看別場
+void RoomManager::endSpectators(Room *room, int loser)
+{
+    QJsonObject root;
+    root["type"] = "game_over";
+    root["room"] = room->id;
+    root["loser"] = loser;
+    QByteArray line = jsonLine(root);
+
+    for (Connection *spectator : room->spectators) {
+        spectator->watching = nullptr;
+        if (!canWrite(spectator)) continue;
+        send(spectator, line);
+        spectator->socket->flush();
+    }
+    room->spectators.clear();
+}
+
+void RoomManager::removeSpectator(Connection *conn)
+{
+    conn->watching->spectators.removeOne(conn);
+    conn->watching = nullptr;
+}
+
+// 每次寫之前都檢查：對方太久沒讀就斷線 (排到事件迴圈再斷，不會在處理訊息途中刪掉連線)
+bool RoomManager::canWrite(Connection *conn)
+{
+    if (!conn || conn->dropping) return false;
+    QTcpSocket *socket = conn->socket;
+    if (socket->state() != QAbstractSocket::ConnectedState) return false;
+    if (socket->bytesToWrite() > maxPending) {
+        qDebug() << "Worker" << workerId << "client stopped reading," << socket->bytesToWrite() << "bytes pending, disconnecting";
+        conn->dropping = true;
+        stats.slowDisconnects.fetch_add(1, std::memory_order_relaxed);
+        QMetaObject::invokeMethod(socket, &QAbstractSocket::abort, Qt::QueuedConnection);
+        return false;
+    }
+    return true;
+}
+
+void RoomManager::writeTo(Connection *conn, const uint8_t *frame, int size)
+{
+    if (canWrite(conn)) send(conn, reinterpret_cast<const char*>(frame), size);
+}
+
+void RoomManager::send(Connection *conn, const char *data, int size)
+{
+    stats.countOut(data, size);
+    conn->socket->write(data, size);
+}
+
+void RoomManager::send(Connection *conn, const QByteArray &data)
+{
+    stats.countOut(data.constData(), data.size());
+    conn->socket->write(data); // QByteArray 版本：共用資料，不複製
+}
+
+// --- PING / PONG (v4) ---
+
+void RoomManager::handlePing(Connection *conn, const FrameDecoder::Message &msg)
+{
+    qint64 received = nowUs();
+    if (msg.type == Protocol::MSG_PING) {
+        Protocol::Pong pong;
+        if (!Protocol::decodePing(msg.payload, msg.payloadSize, pong.id, pong.t0)) return;
+        pong.t1 = received;
+        pong.t2 = nowUs();
+        uint8_t frame[Protocol::MAX_PONG_FRAME];
+        writeTo(conn, frame, Protocol::encodePong(pong, frame));
+        return;
+    }
+
+    Protocol::Pong pong;
+    if (!Protocol::decodePong(msg.payload, msg.payloadSize, pong)) return;
+    conn->clockSync.addSample(pong.t0, pong.t1, pong.t2, received);
+    stats.clientRtt.observe(conn->clockSync.lastRtt() * 1000);
+}
+
+// 比賽中或觀戰中、而且說過支援 v4 的連線才送 (舊版 Client 會把不認得的版本當成壞掉的串流)
+void RoomManager::sendPings()
+{
+    uint8_t frame[Protocol::MAX_PING_FRAME];
+    for (Connection *conn : connections) {
+        if (conn->proto < 4 || (!conn->room && !conn->watching)) continue;
+        writeTo(conn, frame, Protocol::encodePing(conn->clockSync.nextPingId(), nowUs(), frame));
+        if (canWrite(conn)) conn->socket->flush();
+    }
+}
+
+// --- 統計 ---
+
+void RoomManager::startMetrics()
+{
+    probeTimer = new QTimer(this);
+    probeTimer->setTimerType(Qt::PreciseTimer);
+    connect(probeTimer, &QTimer::timeout, this, &RoomManager::onMetricsProbe);
+    nextProbeNs = clock.nsecsElapsed() + METRICS_PROBE_MS * 1000000LL;
+    probeTimer->start(METRICS_PROBE_MS);
+}
+
+void RoomManager::onMetricsProbe()
+{
+    // 計時器比預定時間晚了多少 = 這段時間事件迴圈被佔住多久
+    qint64 now = clock.nsecsElapsed();
+    qint64 lag = qMax<qint64>(0, now - nextProbeNs);
+    nextProbeNs += METRICS_PROBE_MS * 1000000LL;
+    if (nextProbeNs <= now) nextProbeNs = now + METRICS_PROBE_MS * 1000000LL;
+    stats.loopLagNs.store(lag, std::memory_order_relaxed);
+    stats.loopLag.observe(lag);
+    if (++probeCount % PING_EVERY_PROBES == 0) sendPings();
+
+    qint64 queued = 0;
+    qint64 maxQueued = 0;
+    int watching = 0;
+    qint64 rttTotal = 0;
+    qint64 jitterTotal = 0;
+    int measured = 0;
+    for (Connection *conn : connections) {
+        qint64 pending = conn->socket->bytesToWrite();
+        queued += pending;
+        maxQueued = qMax(maxQueued, pending);
+        if (conn->watching) watching++;
+        if (conn->clockSync.sampleCount() > 0) {
+            rttTotal += conn->clockSync.rtt();
+            jitterTotal += conn->clockSync.jitter();
+            measured++;
+        }
+    }
+    stats.clientRttAvgNs.store(measured > 0 ? rttTotal * 1000 / measured : 0, std::memory_order_relaxed);
+    stats.clientJitterAvgNs.store(measured > 0 ? jitterTotal * 1000 / measured : 0, std::memory_order_relaxed);
+    stats.connections.store(connections.size(), std::memory_order_relaxed);
+    stats.rooms.store(activeRooms, std::memory_order_relaxed);
+    stats.spectators.store(watching, std::memory_order_relaxed);
+    stats.queuedBytes.store(queued, std::memory_order_relaxed);
+    stats.maxQueuedBytes.store(maxQueued, std::memory_order_relaxed);
+}
+
+RoomManager::Connection *RoomManager::peerOf(Connection *conn)
+{
+    if (!conn->room) return nullptr;
+    return conn->room->players[0] == conn ? conn->room->players[1] : conn->room->players[0];
+}
+
+void RoomManager::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    Connection *conn = connections.take(socket);
+    if (!conn) return;
+
+    leaveLobby(conn);
+    if (conn->room) closeRoom(conn->room, conn);
+    if (conn->watching) removeSpectator(conn);
+
+    delete conn;
+    socket->deleteLater();
+    qDebug() << "Worker" << workerId << "client disconnected. Remaining:" << connections.size();
+}
@@ -0,0 +1,173 @@
+#ifndef ROOMMANAGER_H
+#define ROOMMANAGER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QTcpSocket>
+#include <QHash>
+#include <QJsonObject>
+#include <QByteArray>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QTimer>
+#include "clocksync.h"
+#include "framedecoder.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "tetrisengine.h"
+
+// 配對與房間管理：每兩個送過 player_info 的玩家組成一個獨立房間，
+// 訊息只轉給同房間的對手。socket -> 連線 -> 房間都是 O(1) 查詢，斷線時也不用掃描列表。
+// 每個 worker thread 一個 RoomManager，裡面的東西只會被自己的 thread 碰到。
+//
+// 配對：整個 Server 只有一個等待位子 (Lobby，有鎖)，送了 player_info 才來搶。位子空著就登記自己等；
+// 有人在等，而且在別的 worker，就把自己的 socket 交給那個 worker 組房間 (等待者先斷線就在那邊重新排)。
+//
+// 權威模式 (authoritative)：兩邊都支援 v3 時，Server 自己用 TetrisEngine 跑每個玩家的遊戲，
+// Client 只送輸入；消行、攻擊、垃圾行的洞、勝負都由 Server 決定，對手畫面也由 Server 產生。
+//
+// 觀戰：房間編號的餘數就是 worker 編號，送錯 worker 的觀戰者會把 socket 交給房間所在的 worker。
+// 每個畫面封包只包一次成 MSG_SPECTATE，同一個 QByteArray 寫給所有觀戰者 (Qt 共用資料，不會每人複製一份)；
+//
+// 流量控制：每條連線看 bytesToWrite()。畫面封包 (會被後面的取代) 超過 VIEW_BUDGET 就丟掉差異，
+// 等對方消化完再補一個 Server 自己維護的最新 keyframe；攻擊、垃圾行、SYNC、game_over 一定送。
+// 超過 maxPending 代表對方根本沒在讀，直接斷線，一個卡住的 Client 不會把 Server 的記憶體撐爆。
+class RoomManager;
+
+// 所有 worker 共用的等待位子：Server 擁有，只在 player_info 之後用，鎖只包住讀寫這兩個欄位
+struct Lobby
+{
+    QMutex lock;
+    RoomManager *worker = nullptr;  // 等待者所在的 worker，nullptr = 沒人在等
+    quint64 ticket = 0;             // 等待者的號碼 (只有那個 worker 自己拿來找連線)
+    quint64 nextTicket = 1;
+};
+
+class RoomManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RoomManager(int workerId = 0, int workerCount = 1, bool authoritative = false,
+                         qint64 maxPending = 1024 * 1024, QObject *parent = nullptr);
+    ~RoomManager();
+
+    // 所有 worker 的 RoomManager 與共用的等待位子，轉交連線用；要在 worker thread 開始跑之前設定好，之後唯讀
+    void setWorkers(const QVector<RoomManager*> &all, Lobby *shared) { workers = all; lobby = shared; }
+
+    int connectionCount() const { return connections.size(); }
+    int roomCount() const { return activeRooms; }
+    // 可以從別的 thread 讀 (MetricsServer)
+    const WorkerMetrics &metrics() const { return stats; }
+
+    // 在 worker thread 上呼叫：用 acceptor 交過來的 descriptor 建立 socket
+    void addConnection(qintptr socketDescriptor);
+    // 在 worker thread 上呼叫：別的 worker 轉交過來的觀戰者 (socket 已經移到這個 thread)
+    void adoptSpectator(QTcpSocket *socket, int roomId, int proto);
+    // 在 worker thread 上呼叫：別的 worker 上剛送完 player_info 的玩家，來跟這裡號碼 ticket 的等待者組房間
+    void adoptPlayer(QTcpSocket *socket, const QByteArray &playerInfo, int proto, quint64 ticket);
+
+public slots:
+    // worker thread 開始跑之後呼叫：計時器要在自己的 thread 上建立
+    void startMetrics();
+
+private slots:
+    void onReadyRead();
+    void onDisconnected();
+    void onMetricsProbe();
+
+private:
+    struct Room;
+
+    struct Connection {
+        QTcpSocket *socket = nullptr;
+        FrameDecoder decoder{12};  // 4 KB ring buffer，最大的 JSON game_state 也放得下
+        bool hasInfo = false;
+        int proto = 0;             // 0 = 只懂 JSON 行
+        QByteArray playerInfo;     // 配對前收到的 player_info，開局時轉給對手
+        quint64 ticket = 0;        // 在 Lobby 等待時的號碼
+        Room *room = nullptr;
+        Room *watching = nullptr;  // 觀戰中的房間
+        bool behind[2] = {false, false}; // 這條連線被丟過玩家 0/1 的差異，下次改送 keyframe
+        bool dropping = false;     // 超過上限，等著斷線
+        ClockSync clockSync;       // v4：Server 送 PING 量到的來回時間與抖動
+
+        // 權威模式：Server 上這個玩家的遊戲
+        TetrisEngine engine;
+        uint16_t nextInput = 0;    // 下一個預期的輸入序號
+
+        // 權威模式：送給對手看的 v2 差異 (跟 Client 的傳送端一樣只送有變的部分)
+        uint16_t viewSeq = 0;
+        int viewUpdates = 0;
+        bool viewKeyframePending = true;
+        TetrisPiece viewPiece{0, 0, 0, 0};
+        int viewHold = -1;
+        int viewNext[NEXT_QUEUE_SIZE] = {};
+    };
+
+    struct Room {
+        int id;
+        Connection *players[2];
+        bool authoritative;
+        quint32 seed;           // 方塊順序與垃圾行的種子，兩個玩家共用
+        int proto;
+
+        // 觀戰：Server 依轉出去的封包自己重建的兩個玩家畫面，落後的觀戰者用它補 keyframe
+        QVector<Connection*> spectators;
+        Protocol::Keyframe views[2];
+        bool viewValid[2];
+    };
+
+    void handleMessage(Connection *conn, const FrameDecoder::Message &msg);
+    void handlePing(Connection *conn, const FrameDecoder::Message &msg);
+    void sendPings();
+    qint64 nowUs() const { return clock.nsecsElapsed() / 1000; }
+    void handleAuthoritative(Connection *conn, const FrameDecoder::Message &msg);
+    void applyInputs(Connection *conn, uint16_t firstSeq, const uint8_t *inputs, int count);
+    void sendGarbage(Connection *attacker, int lines);
+    void sendSync(Connection *conn);
+    void sendView(Connection *subject);
+    void sendViewKeyframe(Connection *subject, Connection *viewer);
+    void finishRoom(Room *room, Connection *loser);
+    void matchPlayer(Connection *conn);
+    void pairPlayers(Connection *first, Connection *second);
+    void leaveLobby(Connection *conn);
+    Connection *attach(QTcpSocket *socket);
+    QTcpSocket *detach(Connection *conn, RoomManager *target);
+    void startRoom(Room *room);
+    void closeRoom(Room *room, Connection *leaver);
+    void spectate(Connection *conn, const QJsonObject &request);
+    void watchRoom(Connection *conn, Room *room);
+    enum ViewAction { VIEW_SKIP, VIEW_FRAME, VIEW_KEYFRAME };
+    void publishView(Room *room, int slot, const uint8_t *frame, int size, Connection *viewer);
+    ViewAction viewAction(Connection *to, int slot, int type, bool delta, bool viewValid);
+    void endSpectators(Room *room, int loser);
+    void removeSpectator(Connection *conn);
+    void sendViewFrame(Connection *subject, Connection *viewer, const uint8_t *frame, int size);
+    static Connection *peerOf(Connection *conn);
+    bool canWrite(Connection *conn);
+    void writeTo(Connection *conn, const uint8_t *frame, int size);
+    // 實際寫進 socket 並計數；呼叫前要先 canWrite
+    void send(Connection *conn, const char *data, int size);
+    void send(Connection *conn, const QByteArray &data);
+
+    int workerId;
+    int workerCount;
+    QVector<RoomManager*> workers;
+    bool authoritative;     // 由命令列 --authoritative 開啟
+    qint64 maxPending;      // 由命令列 --max-pending 設定
+    QHash<QTcpSocket*, Connection*> connections;
+    QHash<int, Room*> rooms;
+    Lobby *lobby;
+    // 這個 worker 上登記在 Lobby 的玩家 (號碼 -> 連線)；位子被別的 worker 拿走、對手還在轉交途中的也在這裡
+    QHash<quint64, Connection*> waiting;
+    int nextRoomId;
+    int activeRooms;
+
+    WorkerMetrics stats;
+    QElapsedTimer clock;
+    QTimer *probeTimer;
+    qint64 nextProbeNs;     // 探測計時器應該觸發的時間，實際晚了多少就是事件迴圈延遲
+    int probeCount;
+};
+
+#endif // ROOMMANAGER_H
@@ -1,84 +1,72 @@
 #include "server.h"
+#include "roommanager.h"
+#include "metrics.h"
 #include <QDebug>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QTcpSocket> // 補上這個 include 比較保險
 
-Server::Server(QObject *parent) : QObject(parent)
+Server::Server(int workerCount, quint16 port, bool authoritative, qint64 maxPending, quint16 metricsPort, QObject *parent)
+    : QObject(parent), metricsServer(nullptr), nextWorker(0)
 {
-    tcpServer = new QTcpServer(this);
-    if(tcpServer->listen(QHostAddress::Any, 12345)){
-        qDebug() << "Tetris Server started on port 12345";
-    } else {
-        qDebug() << "Server failed to start!";
-    }
-    connect(tcpServer, &QTcpServer::newConnection, this, &Server::onNewConnection);
-}
+    if (workerCount <= 0) workerCount = qMax(1, QThread::idealThreadCount());
 
-void Server::onNewConnection()
-{
-    QTcpSocket *clientSocket = tcpServer->nextPendingConnection();
-    clients.append(clientSocket);
+    QVector<RoomManager*> allRooms;
+    for (int i = 0; i < workerCount; ++i) {
+        Worker worker;
+        worker.thread = new QThread(this);
+        worker.thread->setObjectName(QString("RoomWorker-%1").arg(i));
+        worker.rooms = new RoomManager(i, workerCount, authoritative, maxPending);
+        worker.rooms->moveToThread(worker.thread);
+        connect(worker.thread, &QThread::finished, worker.rooms, &QObject::deleteLater);
+        connect(worker.thread, &QThread::started, worker.rooms, &RoomManager::startMetrics);
 
-    connect(clientSocket, &QTcpSocket::readyRead, this, &Server::onReadyRead);
-    connect(clientSocket, &QTcpSocket::disconnected, this, &Server::onDisconnected);
-
-    qDebug() << "Client connected. Total:" << clients.size();
+        workers.append(worker);
+        allRooms.append(worker.rooms);
+    }
 
-    if (clients.size() == 2) {
-        qDebug() << "Match Found! Sending start signal.";
-        QJsonObject root;
-        root["type"] = "start";
+    // 對手與觀戰者可能在別的 worker，先讓每個 worker 知道其他人，再開始跑
+    for (Worker &worker : workers) {
+        worker.rooms->setWorkers(allRooms, &lobby);
+        worker.thread->start();
+    }
 
-        // [修正重點] 使用 Compact 模式，確保 JSON 是一整行，不會被換行符號切斷
-        QByteArray data = QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n";
+    tcpServer = new TcpAcceptor(this);
+    connect(tcpServer, &TcpAcceptor::connectionAccepted, this, &Server::onConnectionAccepted);
+    if(tcpServer->listen(QHostAddress::Any, port)){
+        qDebug() << "Tetris Server started on port" << port << "with" << workerCount << "workers"
+                 << (authoritative ? "(authoritative)" : "");
+    } else {
+        qDebug() << "Server failed to start!";
+    }
 
-        for (QTcpSocket *socket : clients) {
-            if(socket->state() == QAbstractSocket::ConnectedState) {
-                socket->write(data);
-                socket->flush(); // 確保立即送出
-            }
+    // 統計只開在 localhost，要對外請自己用反向代理
+    if (metricsPort > 0) {
+        metricsServer = new MetricsServer(allRooms, this);
+        if (metricsServer->listen(QHostAddress::LocalHost, metricsPort)) {
+            qDebug().noquote() << QString("Metrics on http://127.0.0.1:%1/metrics").arg(metricsPort);
+        } else {
+            qDebug() << "Metrics server failed to start:" << metricsServer->errorString();
         }
     }
 }
 
-void Server::onReadyRead()
+Server::~Server()
 {
-    QTcpSocket *senderSocket = qobject_cast<QTcpSocket*>(sender());
-    if (!senderSocket) return;
-
-    QByteArray data = senderSocket->readAll();
-
-    // 廣播給對手
-    for (QTcpSocket *socket : clients) {
-        if (socket != senderSocket && socket->state() == QAbstractSocket::ConnectedState) {
-            socket->write(data);
-            socket->flush();
-        }
+    tcpServer->close();
+    if (metricsServer) metricsServer->close();
+    for (Worker &worker : workers) {
+        worker.thread->quit();
+        worker.thread->wait();
     }
 }
 
-void Server::onDisconnected()
+void Server::onConnectionAccepted(qintptr socketDescriptor)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (socket) {
-        clients.removeAll(socket);
-        socket->deleteLater();
-        qDebug() << "Client disconnected. Remaining:" << clients.size();
+    // 這時還不知道是玩家還是觀戰者，直接輪流；配對等 player_info 之後由 Lobby 決定
+    int target = nextWorker;
+    nextWorker = (nextWorker + 1) % workers.size();
 
-        // 如果還有人在，通知他遊戲結束
-        if (!clients.isEmpty()) {
-            QJsonObject root;
-            root["type"] = "game_over";
-
-            // [修正重點] 這裡也要記得加 Compact
-            QByteArray data = QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n";
-
-            QTcpSocket* remainingClient = clients.first();
-            if(remainingClient->state() == QAbstractSocket::ConnectedState) {
-                remainingClient->write(data);
-                remainingClient->flush();
-            }
-        }
-    }
+    RoomManager *rooms = workers[target].rooms;
+    QMetaObject::invokeMethod(rooms, [rooms, socketDescriptor]() {
+        rooms->addConnection(socketDescriptor);
+    }, Qt::QueuedConnection);
 }
@@ -4,25 +4,51 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
-#include <QList>
+#include <QThread>
+#include <QVector>
+#include "roommanager.h"
 
+class MetricsServer;
+
+// 只負責 accept：不在 acceptor thread 建立 QTcpSocket，直接把 descriptor 交出去
+class TcpAcceptor : public QTcpServer
+{
+    Q_OBJECT
+public:
+    using QTcpServer::QTcpServer;
+
+signals:
+    void connectionAccepted(qintptr socketDescriptor);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override { emit connectionAccepted(socketDescriptor); }
+};
+
+// 主執行緒只 accept，房間分散到數個 worker thread，每個 worker 有自己的 event loop 與 RoomManager。
+// 新連線輪流分給 worker；送了 player_info 才在共用的 Lobby 決定配對，對手在別的 worker 就把 socket 轉交過去，
+// 所以同一個房間的兩個玩家一定在同一個 worker 上，轉送時不需要任何鎖。觀戰者也一樣轉交到房間所在的 worker。
 class Server : public QObject
 {
     Q_OBJECT
 public:
-    explicit Server(QObject *parent = nullptr);
+    explicit Server(int workerCount = 0, quint16 port = 12345, bool authoritative = false,
+                    qint64 maxPending = 1024 * 1024, quint16 metricsPort = 0, QObject *parent = nullptr);
+    ~Server();
 
 private slots:
-    void onNewConnection();
-    void onReadyRead();
-    void onDisconnected();
+    void onConnectionAccepted(qintptr socketDescriptor);
 
 private:
-    QTcpServer *tcpServer;
-    QList<QTcpSocket*> clients; // 存放所有連進來的玩家
+    struct Worker {
+        QThread *thread;
+        RoomManager *rooms;
+    };
 
-    // 輔助函式：廣播訊息給特定 socket 以外的人
-    void broadcast(const QByteArray &data, QTcpSocket *excludeSocket);
+    TcpAcceptor *tcpServer;
+    MetricsServer *metricsServer;   // --metrics-port 沒設就是 nullptr
+    QVector<Worker> workers;
+    Lobby lobby;
+    int nextWorker;
 };
 
 #endif // SERVER_H
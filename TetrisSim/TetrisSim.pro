@@ -0,0 +1,15 @@
+# 大量電腦自我對局的模擬器：不畫圖，比較規則調整前後的統計 (純 C++，不需要 Qt 函式庫)
+TEMPLATE = app
+TARGET = TetrisSim
+
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+SOURCES += \
+        main.cpp \
+        simulator.cpp
+
+HEADERS += \
+        simulator.h
+
+include(../TetrisEngine/TetrisEngine.pri)
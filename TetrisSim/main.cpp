@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "simulator.h"
+#include "taskpool.h"
+
+// 用法：TetrisSim [options]
+// 大量電腦自我對局，用來比較規則 (分數表、重力曲線、攻擊表) 調整前後的差別。
+// 結果只輸出統計 (CSV 或 JSON)，另外回報每秒幾局與多核心的加速，方便追蹤模擬器本身的效能。
+static void printUsage()
+{
+    std::printf("Usage: TetrisSim [options]\n"
+                "  --games N               number of games (default 1000)\n"
+                "  --mode solo|versus      one bot, or two bots sending garbage (default solo)\n"
+                "  --bot greedy|beam       placement bot (default greedy)\n"
+                "  --beam W,D              beam width and depth for --bot beam (default 16,3)\n"
+                "  --pps X                 simulated pieces per second (default 2.5)\n"
+                "  --max-pieces N          stop a player after N pieces (default 1000)\n"
+                "  --seed S                base seed, game i uses a seed derived from S and i\n"
+                "  --threads N             worker threads including the main one (default: all cores)\n"
+                "  --scaling               also measure games/sec at 1, 2, 4 ... threads\n"
+                "  --format csv|json       output format (default csv)\n"
+                "  --out FILE              write to FILE instead of stdout\n"
+                "rule overrides:\n"
+                "  --line-points a,b,c,d,e score for 0-4 lines (multiplied by level)\n"
+                "  --attack a,b,c,d,e      garbage sent for 0-4 lines\n"
+                "  --points-per-level N    score needed per level\n"
+                "  --max-level N           level cap (score multiplier and gravity stop growing)\n"
+                "  --gravity base,step,min drop interval in ms: base - (level - 1) * step, at least min\n");
+}
+
+// 一局一局的統計累加 (平均、標準差、最小、最大)
+struct Metric
+{
+    double sum = 0;
+    double sumSq = 0;
+    double low = 0;
+    double high = 0;
+    long count = 0;
+
+    void add(double value)
+    {
+        if (count == 0 || value < low) low = value;
+        if (count == 0 || value > high) high = value;
+        sum += value;
+        sumSq += value * value;
+        count++;
+    }
+    void merge(const Metric &other)
+    {
+        if (other.count == 0) return;
+        if (count == 0 || other.low < low) low = other.low;
+        if (count == 0 || other.high > high) high = other.high;
+        sum += other.sum;
+        sumSq += other.sumSq;
+        count += other.count;
+    }
+    double mean() const { return count ? sum / count : 0.0; }
+    double stddev() const
+    {
+        if (count < 2) return 0.0;
+        double m = mean();
+        return std::sqrt(std::max(0.0, sumSq / count - m * m));
+    }
+};
+
+enum MetricId { M_SURVIVAL, M_PIECES, M_LINES, M_GARBAGE_SENT, M_GARBAGE_RECEIVED, M_APM, M_SCORE, M_LEVEL, M_COUNT };
+static const char *const METRIC_NAMES[M_COUNT] = {
+    "survival_s", "pieces", "lines", "garbage_sent", "garbage_received", "apm", "score", "level"
+};
+
+struct Totals
+{
+    Metric metrics[M_COUNT];
+    long games = 0;
+    long pieces = 0;
+    long wins[2] = {0, 0};
+    long draws = 0;
+    long toppedOut = 0;
+    long negativeScores = 0;    // 應該永遠是 0：不是就是分數溢位了
+
+    void add(const SimGameResult &game, int players)
+    {
+        games++;
+        for (int i = 0; i < players; ++i) {
+            const SimPlayerStats &p = game.players[i];
+            metrics[M_SURVIVAL].add(p.seconds);
+            metrics[M_PIECES].add(p.pieces);
+            metrics[M_LINES].add(p.lines);
+            metrics[M_GARBAGE_SENT].add(p.garbageSent);
+            metrics[M_GARBAGE_RECEIVED].add(p.garbageReceived);
+            metrics[M_APM].add(p.seconds > 0 ? p.garbageSent * 60.0 / p.seconds : 0.0);
+            metrics[M_SCORE].add(p.score);
+            metrics[M_LEVEL].add(p.level);
+            pieces += p.pieces;
+            if (p.toppedOut) toppedOut++;
+            if (p.score < 0) negativeScores++;
+        }
+        if (players == 2) {
+            if (game.winner >= 0) wins[game.winner]++;
+            else draws++;
+        }
+    }
+    void merge(const Totals &other)
+    {
+        for (int i = 0; i < M_COUNT; ++i) metrics[i].merge(other.metrics[i]);
+        games += other.games;
+        pieces += other.pieces;
+        wins[0] += other.wins[0];
+        wins[1] += other.wins[1];
+        draws += other.draws;
+        toppedOut += other.toppedOut;
+        negativeScores += other.negativeScores;
+    }
+};
+
+struct RunResult
+{
+    Totals totals;
+    int threads;
+    double seconds;
+    double gamesPerSecond() const { return seconds > 0 ? totals.games / seconds : 0.0; }
+    double piecesPerSecond() const { return seconds > 0 ? totals.pieces / seconds : 0.0; }
+};
+
+static const int GAMES_PER_TASK = 8;     // 一個任務跑幾局，太小的話排程的成本會蓋過一局的時間
+
+// 每一局的種子由基底種子和局數混出來 (splitmix)，換執行緒數結果也一樣
+static uint32_t gameSeed(uint32_t base, long index)
+{
+    uint64_t z = (uint64_t(base) << 32) + uint64_t(index) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<uint32_t>(z ^ (z >> 31));
+}
+
+static RunResult runGames(const SimConfig &config, long games, uint32_t baseSeed, int threads)
+{
+    // 呼叫端自己也會做，所以池子少開一條
+    WorkStealingPool pool(threads > 1 ? threads - 1 : -1);
+    std::mutex totalsLock;
+    RunResult run;
+    run.threads = threads;
+
+    int tasks = static_cast<int>((games + GAMES_PER_TASK - 1) / GAMES_PER_TASK);
+    auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(tasks, [&](int task) {
+        static thread_local std::unique_ptr<Simulator> simulator;
+        if (!simulator) simulator.reset(new Simulator(config));
+
+        Totals local;
+        long end = std::min(games, long(task + 1) * GAMES_PER_TASK);
+        for (long i = long(task) * GAMES_PER_TASK; i < end; ++i) {
+            local.add(simulator->play(gameSeed(baseSeed, i)), config.versus ? 2 : 1);
+        }
+        std::lock_guard<std::mutex> guard(totalsLock);
+        run.totals.merge(local);
+    });
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return run;
+}
+
+static bool parseList(const char *text, int *values, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        char *end = nullptr;
+        values[i] = static_cast<int>(std::strtol(text, &end, 10));
+        if (end == text) return false;
+        if (i + 1 < count) {
+            if (*end != ',') return false;
+            text = end + 1;
+        } else if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void writeCsv(FILE *out, const SimConfig &config, const RunResult &run, const std::vector<RunResult> &scaling)
+{
+    std::fprintf(out, "metric,mean,stddev,min,max\n");
+    for (int i = 0; i < M_COUNT; ++i) {
+        const Metric &m = run.totals.metrics[i];
+        std::fprintf(out, "%s,%.4f,%.4f,%.4f,%.4f\n", METRIC_NAMES[i], m.mean(), m.stddev(), m.low, m.high);
+    }
+
+    std::fprintf(out, "\nstat,value\n");
+    std::fprintf(out, "games,%ld\n", run.totals.games);
+    std::fprintf(out, "topped_out,%ld\n", run.totals.toppedOut);
+    if (config.versus) {
+        std::fprintf(out, "wins_a,%ld\nwins_b,%ld\ndraws,%ld\n", run.totals.wins[0], run.totals.wins[1], run.totals.draws);
+    }
+    std::fprintf(out, "threads,%d\nelapsed_s,%.3f\ngames_per_sec,%.2f\npieces_per_sec,%.0f\n",
+                 run.threads, run.seconds, run.gamesPerSecond(), run.piecesPerSecond());
+
+    if (!scaling.empty()) {
+        std::fprintf(out, "\nthreads,games_per_sec,speedup,efficiency\n");
+        for (const RunResult &s : scaling) {
+            double speedup = s.gamesPerSecond() / scaling[0].gamesPerSecond();
+            std::fprintf(out, "%d,%.2f,%.3f,%.3f\n", s.threads, s.gamesPerSecond(), speedup, speedup / s.threads);
+        }
+    }
+}
+
+static void writeJson(FILE *out, const SimConfig &config, uint32_t seed, const RunResult &run, const std::vector<RunResult> &scaling)
+{
+    const TetrisRules &r = config.rules;
+    std::fprintf(out, "{\n  \"config\": {\"mode\": \"%s\", \"bot\": \"%s\", \"pps\": %.3f, \"max_pieces\": %d, \"seed\": %u,\n",
+                 config.versus ? "versus" : "solo", config.useBeam ? "beam" : "greedy",
+                 config.piecesPerSecond, config.maxPieces, seed);
+    if (config.useBeam) std::fprintf(out, "             \"beam_width\": %d, \"beam_depth\": %d,\n", config.beam.beamWidth, config.beam.depth);
+    std::fprintf(out, "             \"line_points\": [%d, %d, %d, %d, %d], \"attack\": [%d, %d, %d, %d, %d],\n",
+                 r.linePoints[0], r.linePoints[1], r.linePoints[2], r.linePoints[3], r.linePoints[4],
+                 r.attackTable[0], r.attackTable[1], r.attackTable[2], r.attackTable[3], r.attackTable[4]);
+    std::fprintf(out, "             \"points_per_level\": %d, \"max_level\": %d, \"gravity\": [%d, %d, %d]},\n",
+                 r.pointsPerLevel, r.maxLevel, r.baseDropMs, r.dropStepMs, r.minDropMs);
+
+    std::fprintf(out, "  \"games\": %ld,\n  \"topped_out\": %ld,\n", run.totals.games, run.totals.toppedOut);
+    if (config.versus) {
+        std::fprintf(out, "  \"wins_a\": %ld,\n  \"wins_b\": %ld,\n  \"draws\": %ld,\n", run.totals.wins[0], run.totals.wins[1], run.totals.draws);
+    }
+    std::fprintf(out, "  \"metrics\": {\n");
+    for (int i = 0; i < M_COUNT; ++i) {
+        const Metric &m = run.totals.metrics[i];
+        std::fprintf(out, "    \"%s\": {\"mean\": %.4f, \"stddev\": %.4f, \"min\": %.4f, \"max\": %.4f}%s\n",
+                     METRIC_NAMES[i], m.mean(), m.stddev(), m.low, m.high, i + 1 < M_COUNT ? "," : "");
+    }
+    std::fprintf(out, "  },\n  \"performance\": {\"threads\": %d, \"elapsed_s\": %.3f, \"games_per_sec\": %.2f, \"pieces_per_sec\": %.0f}",
+                 run.threads, run.seconds, run.gamesPerSecond(), run.piecesPerSecond());
+
+    if (!scaling.empty()) {
+        std::fprintf(out, ",\n  \"scaling\": [\n");
+        for (size_t i = 0; i < scaling.size(); ++i) {
+            const RunResult &s = scaling[i];
+            double speedup = s.gamesPerSecond() / scaling[0].gamesPerSecond();
+            std::fprintf(out, "    {\"threads\": %d, \"games_per_sec\": %.2f, \"speedup\": %.3f, \"efficiency\": %.3f}%s\n",
+                         s.threads, s.gamesPerSecond(), speedup, speedup / s.threads, i + 1 < scaling.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]");
+    }
+    std::fprintf(out, "\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    SimConfig config;
+    config.versus = false;
+    config.useBeam = false;
+    config.beam = BeamSettings{16, 3, 0}; // 不限時，同一個種子每次跑出一樣的結果
+    config.piecesPerSecond = 2.5;
+    config.maxPieces = 1000;
+    config.rules = DEFAULT_RULES;
+
+    long games = 1000;
+    uint32_t seed = 1;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    bool scaling = false;
+    bool json = false;
+    const char *outPath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+
+        if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+            printUsage();
+            return 0;
+        } else if (std::strcmp(arg, "--scaling") == 0) {
+            scaling = true;
+            continue;
+        } else if (!value) {
+            ok = false;
+        } else if (std::strcmp(arg, "--games") == 0) {
+            games = std::strtol(value, nullptr, 10);
+            ok = games > 0;
+        } else if (std::strcmp(arg, "--mode") == 0) {
+            config.versus = std::strcmp(value, "versus") == 0;
+            ok = config.versus || std::strcmp(value, "solo") == 0;
+        } else if (std::strcmp(arg, "--bot") == 0) {
+            config.useBeam = std::strcmp(value, "beam") == 0;
+            ok = config.useBeam || std::strcmp(value, "greedy") == 0;
+        } else if (std::strcmp(arg, "--beam") == 0) {
+            int wd[2];
+            ok = parseList(value, wd, 2) && wd[0] > 0 && wd[1] > 0;
+            config.beam.beamWidth = wd[0];
+            config.beam.depth = wd[1];
+        } else if (std::strcmp(arg, "--pps") == 0) {
+            config.piecesPerSecond = std::strtod(value, nullptr);
+            ok = config.piecesPerSecond > 0;
+        } else if (std::strcmp(arg, "--max-pieces") == 0) {
+            config.maxPieces = static_cast<int>(std::strtol(value, nullptr, 10));
+            ok = config.maxPieces > 0;
+        } else if (std::strcmp(arg, "--seed") == 0) {
+            seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (std::strcmp(arg, "--threads") == 0) {
+            threads = static_cast<int>(std::strtol(value, nullptr, 10));
+            ok = threads > 0;
+        } else if (std::strcmp(arg, "--format") == 0) {
+            json = std::strcmp(value, "json") == 0;
+            ok = json || std::strcmp(value, "csv") == 0;
+        } else if (std::strcmp(arg, "--out") == 0) {
+            outPath = value;
+        } else if (std::strcmp(arg, "--line-points") == 0) {
+            ok = parseList(value, config.rules.linePoints, 5);
+        } else if (std::strcmp(arg, "--attack") == 0) {
+            ok = parseList(value, config.rules.attackTable, 5);
+        } else if (std::strcmp(arg, "--points-per-level") == 0) {
+            config.rules.pointsPerLevel = static_cast<int>(std::strtol(value, nullptr, 10));
+            ok = config.rules.pointsPerLevel > 0;
+        } else if (std::strcmp(arg, "--max-level") == 0) {
+            config.rules.maxLevel = static_cast<int>(std::strtol(value, nullptr, 10));
+            ok = config.rules.maxLevel > 0;
+        } else if (std::strcmp(arg, "--gravity") == 0) {
+            int g[3];
+            ok = parseList(value, g, 3) && g[0] > 0 && g[2] > 0;
+            config.rules.baseDropMs = g[0];
+            config.rules.dropStepMs = g[1];
+            config.rules.minDropMs = g[2];
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::fprintf(stderr, "invalid option: %s%s%s\n", arg, value ? " " : "", value ? value : "");
+            printUsage();
+            return 1;
+        }
+        i++;
+    }
+    if (threads <= 0) threads = 1;
+
+    FILE *out = stdout;
+    if (outPath) {
+        out = std::fopen(outPath, "w");
+        if (!out) {
+            std::fprintf(stderr, "%s: cannot open for writing\n", outPath);
+            return 1;
+        }
+    }
+
+    // 加速比用比較少的局數量，1, 2, 4 ... 一直到指定的執行緒數
+    std::vector<RunResult> scalingRuns;
+    if (scaling) {
+        long sample = std::min(games, 1000L);
+        for (int t = 1;; t = std::min(t * 2, threads)) {
+            scalingRuns.push_back(runGames(config, sample, seed, t));
+            std::fprintf(stderr, "scaling: %d threads, %.2f games/sec\n", t, scalingRuns.back().gamesPerSecond());
+            if (t == threads) break;
+        }
+    }
+
+    RunResult run = runGames(config, games, seed, threads);
+    if (json) writeJson(out, config, seed, run, scalingRuns);
+    else writeCsv(out, config, run, scalingRuns);
+
+    if (out != stdout) std::fclose(out);
+    if (run.totals.negativeScores > 0) {
+        std::fprintf(stderr, "error: %ld players ended with a negative score (score overflow)\n", run.totals.negativeScores);
+        return 2;
+    }
+    return 0;
+}
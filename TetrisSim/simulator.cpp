@@ -0,0 +1,86 @@
+#include "simulator.h"
+
+Simulator::Simulator(const SimConfig &config)
+    : settings(config), beam(DEFAULT_BOT_WEIGHTS, -1) // 平行交給外面的對局，搜尋本身不再開執行緒
+{
+}
+
+void Simulator::resetPlayer(Player &player, uint32_t seed)
+{
+    player.engine.setRules(settings.rules);
+    player.engine.reset(seed);
+    player.stats = SimPlayerStats{0, 0, 0, 0, 0, 1, false, 0.0};
+    player.clock = 0.0;
+    player.gravityCarry = 0.0;
+}
+
+int Simulator::playPiece(Player &player)
+{
+    TetrisEngine &engine = player.engine;
+    LockResult result{};
+    bool locked = false;
+
+    // 出塊間隔內該掉的格數先掉下去，掉到底掉不動就跟鎖定計時器到期一樣直接鎖定
+    double pieceMs = 1000.0 / settings.piecesPerSecond;
+    player.gravityCarry += pieceMs;
+    while (!locked && player.gravityCarry >= engine.dropSpeed()) {
+        player.gravityCarry -= engine.dropSpeed();
+        if (!engine.step()) locked = engine.applyInput(INPUT_LOCK, result);
+    }
+
+    if (!locked) {
+        BotPlan plan = settings.useBeam ? beam.search(engine, settings.beam) : greedy.plan(engine);
+        if (plan.found) {
+            for (int i = 0; i < plan.inputCount && !locked; ++i) locked = engine.applyInput(plan.inputs[i], result);
+        }
+        if (!locked) result = engine.hardDrop();
+    }
+    player.gravityCarry = 0.0; // 新的方塊重新計時
+
+    player.clock += 1.0 / settings.piecesPerSecond;
+    player.stats.pieces++;
+    player.stats.lines += result.linesCleared;
+    player.stats.garbageSent += result.attack;
+    player.stats.toppedOut = engine.isGameOver();
+    return result.attack;
+}
+
+SimGameResult Simulator::play(uint32_t seed)
+{
+    Player players[2];
+    int count = settings.versus ? 2 : 1;
+    // 對戰兩邊同一個種子 (跟連線對戰一樣同一串方塊)；單人時第二位只是空的統計
+    for (Player &player : players) resetPlayer(player, seed);
+
+    SimGameResult game;
+    game.seed = seed;
+    game.winner = -1;
+
+    for (;;) {
+        // 模擬時間落後的那位先放，兩邊交錯進行
+        int turn = (count == 2 && players[1].clock < players[0].clock) ? 1 : 0;
+        Player &self = players[turn];
+        if (self.stats.pieces >= settings.maxPieces) break;
+
+        int attack = playPiece(self);
+        if (count == 2 && attack > 0) {
+            Player &other = players[1 - turn];
+            other.engine.addGarbageLines(attack);
+            other.stats.garbageReceived += attack;
+            other.stats.toppedOut = other.engine.isGameOver();
+        }
+
+        if (players[0].stats.toppedOut || (count == 2 && players[1].stats.toppedOut)) break;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        players[i].stats.score = players[i].engine.score();
+        players[i].stats.level = players[i].engine.level();
+        players[i].stats.seconds = players[i].clock;
+        game.players[i] = players[i].stats;
+    }
+    if (count == 2 && players[0].stats.toppedOut != players[1].stats.toppedOut) {
+        game.winner = players[0].stats.toppedOut ? 1 : 0;
+    }
+    return game;
+}
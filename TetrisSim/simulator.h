@@ -0,0 +1,64 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <cstdint>
+#include "beamsearch.h"
+
+// 不畫圖、不等計時器的對局模擬：電腦直接決定每一顆怎麼放，時間用「每秒幾顆」換算，
+// 重力照規則的 dropSpeed 在出生後先往下掉，所以改重力曲線也會影響結果。
+
+struct SimConfig
+{
+    bool versus;            // false = 單人，true = 兩個電腦互送垃圾行
+    bool useBeam;           // false = TetrisBot (一層)，true = BeamSearchBot
+    BeamSettings beam;
+    double piecesPerSecond; // 模擬的出塊速度 (決定存活時間、APM 與重力)
+    int maxPieces;          // 每個玩家最多放幾顆就算平手結束
+    TetrisRules rules;
+};
+
+struct SimPlayerStats
+{
+    int pieces;
+    int lines;
+    int garbageSent;
+    int garbageReceived;
+    int score;
+    int level;
+    bool toppedOut;
+    double seconds;
+};
+
+struct SimGameResult
+{
+    uint32_t seed;
+    int winner;             // 對戰：0 / 1，-1 = 平手 (單人一律 -1)
+    SimPlayerStats players[2];
+};
+
+// 每個執行緒各自一個，電腦的暫存 (beam 的執行緒池) 重複使用
+class Simulator
+{
+public:
+    explicit Simulator(const SimConfig &config);
+
+    SimGameResult play(uint32_t seed);
+
+private:
+    struct Player {
+        TetrisEngine engine;
+        SimPlayerStats stats;
+        double clock;           // 這位玩家的模擬時間 (秒)
+        double gravityCarry;    // 還沒換成重力的毫秒
+    };
+
+    void resetPlayer(Player &player, uint32_t seed);
+    // 放一顆方塊，回傳送出的垃圾行
+    int playPiece(Player &player);
+
+    SimConfig settings;
+    TetrisBot greedy;
+    BeamSearchBot beam;
+};
+
+#endif // SIMULATOR_H
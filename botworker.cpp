@@ -0,0 +1,13 @@
+#include "botworker.h"
+
+BotWorker::BotWorker(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<BotPlan>("BotPlan");
+}
+
+void BotWorker::think(int requestId, const TetrisEngine &engine, const BeamSettings &settings)
+{
+    BotPlan plan = searcher.search(engine, settings);
+    emit planReady(requestId, plan);
+}
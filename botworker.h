@@ -0,0 +1,28 @@
+#ifndef BOTWORKER_H
+#define BOTWORKER_H
+
+#include <QObject>
+#include <QMetaType>
+#include "beamsearch.h"
+
+Q_DECLARE_METATYPE(BotPlan)
+
+// 在背景執行緒跑 beam search (搜尋本身再分給 work-stealing pool)，
+// 算完用 signal 把結果送回 GUI thread，gameLoop 不會被卡住
+class BotWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BotWorker(QObject *parent = nullptr);
+
+    // 在 worker thread 上呼叫，engine 是 GUI thread 複製過來的快照
+    void think(int requestId, const TetrisEngine &engine, const BeamSettings &settings);
+
+signals:
+    void planReady(int requestId, const BotPlan &plan);
+
+private:
+    BeamSearchBot searcher;
+};
+
+#endif // BOTWORKER_H
@@ -0,0 +1,96 @@
+#include "frameprofiler.h"
+#include <QFile>
+#include <QCoreApplication>
+#include <algorithm>
+
+FrameProfiler::FrameProfiler()
+    : lastPaintNs(-1), tracing(false)
+{
+    clock.start();
+}
+
+void FrameProfiler::reset()
+{
+    paintSamples.clear();
+    intervalSamples.clear();
+    keyToPixelSamples.clear();
+    lastPaintNs = -1;
+}
+
+void FrameProfiler::recordPaint(qint64 startNs, qint64 endNs)
+{
+    paintSamples.add(endNs - startNs);
+    if (lastPaintNs >= 0) intervalSamples.add(startNs - lastPaintNs);
+    lastPaintNs = startNs;
+    addSpan("paintEvent", startNs, endNs);
+}
+
+void FrameProfiler::Samples::add(qint64 ns)
+{
+    if (values.size() < HISTORY) {
+        values.append(ns);
+        return;
+    }
+    values[next] = ns;
+    next = (next + 1) % HISTORY;
+}
+
+FrameProfiler::Summary FrameProfiler::Samples::summary() const
+{
+    Summary result{int(values.size()), 0.0, 0.0, 0.0};
+    if (values.isEmpty()) return result;
+
+    QVector<qint64> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](int p) {
+        int index = qMin(int(sorted.size()) - 1, int(sorted.size()) * p / 100);
+        return sorted[index] / 1e6;
+    };
+    result.p50Ms = percentile(50);
+    result.p95Ms = percentile(95);
+    result.p99Ms = percentile(99);
+    return result;
+}
+
+void FrameProfiler::startTrace()
+{
+    events.clear();
+    events.reserve(64 * 1024);
+    tracing = true;
+}
+
+void FrameProfiler::stopTrace()
+{
+    tracing = false;
+}
+
+void FrameProfiler::addSpan(const char *name, qint64 startNs, qint64 endNs)
+{
+    if (!tracing || events.size() >= MAX_TRACE_EVENTS) return;
+    events.append(TraceEvent{name, startNs, endNs - startNs});
+}
+
+// Trace Event Format 的 "X" (complete) 事件，時間單位是微秒
+bool FrameProfiler::writeTrace(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    qint64 pid = QCoreApplication::applicationPid();
+    QByteArray out;
+    out.reserve(events.size() * 80 + 256);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(pid)
+         + ",\"tid\":1,\"args\":{\"name\":\"GUI\"}}";
+    for (const TraceEvent &event : events) {
+        out += ",\n{\"name\":\"";
+        out += event.name;
+        out += "\",\"cat\":\"client\",\"ph\":\"X\",\"pid\":" + QByteArray::number(pid) + ",\"tid\":1,\"ts\":";
+        out += QByteArray::number(event.startNs / 1000.0, 'f', 3);
+        out += ",\"dur\":";
+        out += QByteArray::number(event.durationNs / 1000.0, 'f', 3);
+        out += "}";
+    }
+    out += "\n]}\n";
+    return file.write(out) == out.size();
+}
@@ -0,0 +1,80 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+// Client 的效能量測：最近幾百個畫面的繪圖時間、畫面間隔、按鍵到畫面的延遲 (HUD 顯示百分位數)，
+// 以及開著時記錄的區段 (gameLoop / paintEvent ...)，可以存成 Chrome trace (chrome://tracing、Perfetto 都能開)。
+// 時間一律是同一個 QElapsedTimer 的奈秒數，只在 GUI thread 使用。
+class FrameProfiler
+{
+public:
+    static const int HISTORY = 240;             // 大約 4 秒的 60 Hz 畫面
+    static const int MAX_TRACE_EVENTS = 500000; // 超過就不再記，避免忘了關的時候吃光記憶體
+
+    struct Summary {
+        int count;
+        double p50Ms;
+        double p95Ms;
+        double p99Ms;
+    };
+
+    // 區段：建構時開始，解構時結束 (只在錄 trace 時記錄)
+    class Span {
+    public:
+        Span(FrameProfiler &profiler, const char *name) : profiler(profiler), name(name), start(profiler.now()) {}
+        ~Span() { profiler.addSpan(name, start, profiler.now()); }
+    private:
+        FrameProfiler &profiler;
+        const char *name;
+        qint64 start;
+    };
+
+    FrameProfiler();
+
+    qint64 now() const { return clock.nsecsElapsed(); }
+    void reset();
+
+    void recordPaint(qint64 startNs, qint64 endNs);
+    void recordKeyToPixel(qint64 ns) { keyToPixelSamples.add(ns); }
+
+    Summary paintTime() const { return paintSamples.summary(); }
+    Summary frameInterval() const { return intervalSamples.summary(); }
+    Summary keyToPixel() const { return keyToPixelSamples.summary(); }
+
+    bool isTracing() const { return tracing; }
+    void startTrace();
+    void stopTrace();
+    void addSpan(const char *name, qint64 startNs, qint64 endNs);
+    bool writeTrace(const QString &path) const;
+    int traceEventCount() const { return events.size(); }
+
+private:
+    // 固定大小的環狀紀錄，滿了就蓋掉最舊的
+    struct Samples {
+        QVector<qint64> values;
+        int next = 0;
+        void add(qint64 ns);
+        void clear() { values.clear(); next = 0; }
+        Summary summary() const;
+    };
+
+    struct TraceEvent {
+        const char *name;   // 一律是字串常數
+        qint64 startNs;
+        qint64 durationNs;
+    };
+
+    QElapsedTimer clock;
+    Samples paintSamples;
+    Samples intervalSamples;
+    Samples keyToPixelSamples;
+    qint64 lastPaintNs;
+
+    bool tracing;
+    QVector<TraceEvent> events;
+};
+
+#endif // FRAMEPROFILER_H
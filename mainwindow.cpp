@@ -1,13 +1,19 @@
 #include "mainwindow.h"
+#include "piecetables.h"
+#include "protocol.h"
 #include <QPainter>
+#include <QPaintEvent>
 #include <QKeyEvent>
 #include <QDebug>
 #include <QMessageBox>
 #include <QInputDialog>
-#include <cstdlib>
-#include <ctime>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QDir>
+#include <QDateTime>
+#include <QFile>
 #include <algorithm>
-#include <random>
+#include <cstring>
 
 // JSON
 #include <QJsonDocument>
@@ -19,20 +25,53 @@
 #include <QAudioOutput>
 #include <QSoundEffect>
 
-const int GAME_COLS = 10;
-const int GAME_ROWS = 20;
 const int CELL_SIZE = 30;
+const int QUEUE_CELL_SIZE = 20;
 const int BOARD_PIXEL_W = GAME_COLS * CELL_SIZE;
 const int BOARD_PIXEL_H = GAME_ROWS * CELL_SIZE;
+const int SENT_NEXT_COUNT = 3; // 對手畫面只顯示 3 個 NEXT
+const int MAX_CATCHUP_TICKS = 10; // 一次最多補跑的 tick 數
+const qint64 SEND_BUDGET_BYTES = 32 * 1024; // 還沒送出的資料超過這個量，狀態就先不送
+const qint64 HUD_REFRESH_NS = 250 * 1000000LL; // HUD 每秒更新 4 次
+const int PING_INTERVAL_MS = 1000; // 每秒量一次到 Server 的來回時間
+
+// 電腦難度：inputInterval 是每個輸入的間隔 (ms)；beamWidth = 0 表示只看目前這顆的 TetrisBot，
+// 直接在 GUI thread 算 (不到 0.1 ms)，其他的用 beam search 在背景算，timeBudgetMs 是每顆的思考時間上限
+struct CpuLevel
+{
+    const char *name;
+    int inputInterval;
+    BeamSettings beam;
+};
+
+const CpuLevel CPU_LEVELS[] = {
+    {"簡單", 150, {0, 1, 0}},
+    {"普通", 60, {0, 1, 0}},
+    {"困難", 40, {16, 3, 10}},
+    {"地獄", 25, {64, 6, 40}},
+};
+const int CPU_LEVEL_COUNT = sizeof(CPU_LEVELS) / sizeof(CPU_LEVELS[0]);
+
+static bool samePiece(const TetrisPiece &a, const TetrisPiece &b)
+{
+    return a.shape == b.shape && a.rotation == b.rotation && a.x == b.x && a.y == b.y;
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , isGameMode(false), isOnlineMode(false)
-    , isPaused(false), isGameOver(false), isWaitingForOpponent(false)
-    , score(0), level(1), heldShape(0), canHold(true)
-    , opponentHold(0)
-    , timer(nullptr), lockTimer(nullptr), socket(nullptr)
-    , menuWidget(nullptr), titleLabel(nullptr), nameInput(nullptr)
+    , isPaused(false), isGameOver(false), isWaitingForOpponent(false), isCpuMode(false)
+    , tickBase(0), fallOffset(0), inputLatencyTotal(0), inputLatencyCount(0), inputLatencyMax(0)
+    , showHud(false), lastHudNs(0)
+    , opponentHold(0), opponentSeq(0), opponentSynced(false), keyframeRequested(false)
+    , sendSeq(0), updatesSinceKeyframe(0), keyframePending(true), lastSentHold(-1)
+    , stateDirty(false), sendIntervalMs(16), framesSent(0), framesCoalesced(0)
+    , sendDisconnectBytes(1024 * 1024), framesDeferred(0)
+    , isAuthoritative(false), inputSeq(0), pendingFirstInput(0), corrections(0), serverAck(0), matchSeed(0)
+    , wireVersion(0), serverPings(false)
+    , timer(nullptr), sendTimer(nullptr), pingTimer(nullptr), cpuTimer(nullptr), cpuPlanPos(0), cpuDifficulty(1)
+    , botThread(nullptr), botWorker(nullptr), cpuRequestId(0), cpuThinking(false), socket(nullptr)
+    , menuWidget(nullptr), titleLabel(nullptr), nameInput(nullptr), difficultyBox(nullptr)
     , btnLocal(nullptr), btnOnline(nullptr), btnBack(nullptr)
     , bgmPlayer(nullptr), bgmOutput(nullptr), clearSound(nullptr)
 {
@@ -43,19 +82,66 @@ MainWindow::MainWindow(QWidget *parent)
     pal.setColor(QPalette::Window, QColor(30, 30, 30));
     setPalette(pal);
 
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
-
-    board.resize(GAME_COLS * GAME_ROWS);
-    board.fill(0);
-    opponentBoard.resize(GAME_COLS * GAME_ROWS);
-    opponentBoard.fill(0);
-
+    titleFont = font();
+    titleFont.setBold(true);
+    titleFont.setPointSize(16);
+    statFont = titleFont;
+    statFont.setPointSize(12);
+    queueFont = titleFont;
+    queueFont.setPointSize(10);
+    messageFont = font();
+    messageFont.setPointSize(24);
+    pauseFont = titleFont;
+    pauseFont.setPointSize(40);
+    hudFont = QFont("Monospace");
+    hudFont.setStyleHint(QFont::TypeWriter);
+    hudFont.setPointSize(9);
+
+    opponentBoard.clear();
+    opponentFalling = TetrisPiece{0, 0, 0, 0};
+    opponentRevision = 0;
+    cpuViewRevision = 0;
+    myBoardLayer.valid = false;
+    opponentBoardLayer.valid = false;
+    opponentLocked.clear();
+    opponentPiece = TetrisPiece{0, 0, 0, 0};
+    lastSentPiece = TetrisPiece{0, 0, 0, 0};
+
+    // 遊戲計時器固定 60 Hz (跟等級無關)，準度要到 ms，不然 tick 會一下多一下少
     timer = new QTimer(this);
+    timer->setTimerType(Qt::PreciseTimer);
+    timer->setInterval(1000 / TICKS_PER_SECOND);
     connect(timer, &QTimer::timeout, this, &MainWindow::gameLoop);
 
-    lockTimer = new QTimer(this);
-    lockTimer->setSingleShot(true);
-    connect(lockTimer, &QTimer::timeout, this, &MainWindow::pieceDropped);
+    // 送出合併用的計時器，頻率可用環境變數 TETRIS_SEND_HZ 調整 (預設 60 Hz)
+    int sendHz = qEnvironmentVariableIntValue("TETRIS_SEND_HZ");
+    if (sendHz <= 0) sendHz = 60;
+    sendIntervalMs = qMax(1, 1000 / sendHz);
+    sendTimer = new QTimer(this);
+    sendTimer->setSingleShot(true);
+    sendTimer->setTimerType(Qt::PreciseTimer);
+    connect(sendTimer, &QTimer::timeout, this, &MainWindow::flushGameState);
+
+    pingTimer = new QTimer(this);
+    pingTimer->setInterval(PING_INTERVAL_MS);
+    connect(pingTimer, &QTimer::timeout, this, &MainWindow::sendPing);
+
+    // 沒送出去的資料超過這個量 (KB) 就斷線，可用環境變數 TETRIS_MAX_PENDING_KB 調整
+    int maxPendingKb = qEnvironmentVariableIntValue("TETRIS_MAX_PENDING_KB");
+    if (maxPendingKb > 0) sendDisconnectBytes = qMax(qint64(maxPendingKb) * 1024, 2 * SEND_BUDGET_BYTES);
+
+    cpuPlan.found = false;
+    cpuTimer = new QTimer(this);
+    connect(cpuTimer, &QTimer::timeout, this, &MainWindow::cpuStep);
+
+    // beam search 的背景執行緒 (跟 Server 的 worker 一樣：QThread + moveToThread)
+    botThread = new QThread(this);
+    botThread->setObjectName("BotWorker");
+    botWorker = new BotWorker;
+    botWorker->moveToThread(botThread);
+    connect(botThread, &QThread::finished, botWorker, &QObject::deleteLater);
+    connect(botWorker, &BotWorker::planReady, this, &MainWindow::onCpuPlanReady);
+    botThread->start();
 
     socket = new QTcpSocket(this);
     connect(socket, &QTcpSocket::connected, this, &MainWindow::onSocketConnected);
@@ -92,6 +178,8 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    botThread->quit();
+    botThread->wait();
 }
 
 // --- 初始化選單 ---
@@ -142,7 +230,7 @@ void MainWindow::initMenu()
 
     QString btnStyle = "QPushButton { font-size: 20px; padding: 15px; background-color: #4CAF50; color: white; border-radius: 8px; font-weight: bold; min-width: 200px; } QPushButton:hover { background-color: #45a049; } QPushButton:disabled { background-color: #555; color: #aaa; }";
 
-    btnLocal = new QPushButton("單人練習 (Local)", this);
+    btnLocal = new QPushButton("電腦對戰 (Local)", this);
     btnOnline = new QPushButton("多人對戰 (Online)", this);
     btnLocal->setStyleSheet(btnStyle);
     btnOnline->setStyleSheet(btnStyle);
@@ -168,8 +256,20 @@ void MainWindow::initMenu()
     nameInput->setAlignment(Qt::AlignCenter);
     nameInput->setStyleSheet("QLineEdit { font-size: 20px; padding: 10px; border-radius: 5px; background-color: #eee; color: #333; border: 2px solid #555; } QLineEdit:focus { border: 2px solid #4CAF50; }");
 
+    QLabel *difficultyLabel = new QLabel("電腦難度", this);
+    difficultyLabel->setStyleSheet("color: #AAA; font-size: 16px; font-weight: bold;");
+    difficultyLabel->setAlignment(Qt::AlignHCenter);
+
+    difficultyBox = new QComboBox(this);
+    for (int i = 0; i < CPU_LEVEL_COUNT; ++i) difficultyBox->addItem(CPU_LEVELS[i].name);
+    difficultyBox->setCurrentIndex(cpuDifficulty);
+    difficultyBox->setFixedWidth(200);
+    difficultyBox->setStyleSheet("QComboBox { font-size: 18px; padding: 8px; border-radius: 5px; background-color: #eee; color: #333; border: 2px solid #555; }");
+
     rightLayout->addWidget(nameLabel);
     rightLayout->addWidget(nameInput);
+    rightLayout->addWidget(difficultyLabel);
+    rightLayout->addWidget(difficultyBox);
 
     // 組合
     contentLayout->addStretch(1);
@@ -203,6 +303,8 @@ void MainWindow::onLocalBattleClicked()
 
     isGameMode = true;
     isOnlineMode = false;
+    isCpuMode = true;
+    cpuDifficulty = qBound(0, difficultyBox->currentIndex(), CPU_LEVEL_COUNT - 1);
     isWaitingForOpponent = false;
     menuWidget->hide();
     startGame();
@@ -230,11 +332,18 @@ void MainWindow::onSocketConnected()
 {
     menuWidget->hide();
     isOnlineMode = true;
-    opponentBoard.fill(0);
+    isCpuMode = false;
+    opponentBoard.clear();
+    opponentFalling = TetrisPiece{0, 0, 0, 0};
+    opponentRevision++;
     opponentNextPieces.clear();
     opponentHold = 0;
     opponentName = "Connecting...";
     isWaitingForOpponent = true;
+    wireVersion = 0;
+    isAuthoritative = false;
+    serverPings = false;
+    decoder.reset();
     isGameMode = true;
 
     btnBack->show();
@@ -258,8 +367,14 @@ void MainWindow::onSocketDisconnected()
 void MainWindow::onBackClicked()
 {
     timer->stop();
+    sendTimer->stop();
+    pingTimer->stop();
+    cpuTimer->stop();
+    stateDirty = false;
+    closeReplay();
     isGameMode = false;
     isOnlineMode = false;
+    isCpuMode = false;
     isPaused = false;
 
     // [新增] 停止音樂
@@ -283,58 +398,416 @@ void MainWindow::onBackClicked()
 
 void MainWindow::onSocketReadyRead()
 {
-    QByteArray data = socket->readAll();
-    QList<QByteArray> messages = data.split('\n');
+    // 直接從 socket 讀進 decoder 的 ring buffer，每切出一則完整訊息就當場處理，
+    // 沒收完的留在 buffer 裡等下一次 readyRead
+    for (;;) {
+        int space = decoder.writableSize();
+        if (space > 0 && socket->bytesAvailable() > 0) {
+            qint64 n = socket->read(reinterpret_cast<char*>(decoder.writePointer()), space);
+            if (n > 0) decoder.commit(int(n));
+        }
 
-    for(const QByteArray &msg : messages) {
-        if(msg.isEmpty()) continue;
-        QJsonDocument doc = QJsonDocument::fromJson(msg);
-        if(!doc.isObject()) continue;
+        FrameDecoder::Message msg;
+        FrameDecoder::Result result;
+        while ((result = decoder.next(msg)) == FrameDecoder::MessageReady) {
+            if (msg.binary) {
+                handleBinaryFrame(msg.type, msg.payload, msg.payloadSize);
+            } else {
+                QJsonDocument doc = QJsonDocument::fromJson(QByteArray::fromRawData(reinterpret_cast<const char*>(msg.payload), msg.payloadSize));
+                if (doc.isObject()) handleJsonMessage(doc.object());
+            }
+            if (socket->state() != QAbstractSocket::ConnectedState) return;
+        }
 
-        QJsonObject root = doc.object();
-        QString type = root["type"].toString();
+        if (result == FrameDecoder::Malformed) {
+            qDebug() << "Malformed stream from server, disconnecting";
+            decoder.reset();
+            socket->disconnectFromHost();
+            return;
+        }
+        if (socket->bytesAvailable() <= 0) return;
+    }
+}
 
-        if (type == "player_info") {
-            if(root.contains("name")) {
-                opponentName = root["name"].toString();
-                if(opponentName.isEmpty()) opponentName = "Opponent";
-                update();
-            }
+void MainWindow::handleJsonMessage(const QJsonObject &root)
+{
+    QString type = root["type"].toString();
+
+    if (type == "player_info") {
+        if(root.contains("name")) {
+            opponentName = root["name"].toString();
+            if(opponentName.isEmpty()) opponentName = "Opponent";
+            update();
         }
-        else if (type == "start" || type == "game_start") {
-            isWaitingForOpponent = false;
-            startGame();
+    }
+    else if (type == "start" || type == "game_start") {
+        // 舊版 Server 不會帶 proto，維持 JSON
+        wireVersion = qBound(0, root["proto"].toInt(0), Protocol::PROTOCOL_VERSION);
+        isAuthoritative = wireVersion >= 3 && root["mode"].toString() == "authoritative";
+        // 舊版 Server 不給種子就自己抽一個
+        matchSeed = root.contains("seed") ? static_cast<quint32>(root["seed"].toDouble())
+                                          : QRandomGenerator::global()->generate();
+        isWaitingForOpponent = false;
+        // 量來回時間看的是 Server 自己的版本，對手是舊版也一樣能量
+        serverPings = root["server_proto"].toInt(0) >= 4;
+        serverClock.reset();
+        if (serverPings) {
+            sendPing();
+            pingTimer->start();
         }
-        else if (type == "game_state") {
-            if(root.contains("board")) {
-                QJsonArray arr = root["board"].toArray();
-                if(opponentBoard.size() != GAME_COLS * GAME_ROWS)
-                    opponentBoard.resize(GAME_COLS * GAME_ROWS);
-                opponentBoard.fill(0);
-                for (int i=0; i < qMin(arr.size(), opponentBoard.size()); ++i)
-                    opponentBoard[i] = arr[i].toInt();
-            }
-            if(root.contains("hold")) {
-                opponentHold = root["hold"].toInt();
-            }
-            if(root.contains("next_queue")) {
-                QJsonArray nextArr = root["next_queue"].toArray();
-                opponentNextPieces.clear();
-                for(auto v : nextArr) {
-                    opponentNextPieces.append(v.toInt());
-                }
+        startGame();
+    }
+    else if (type == "game_state") {
+        Protocol::GameState state;
+        state.board.clear();
+        if(root.contains("board")) {
+            QJsonArray arr = root["board"].toArray();
+            for (int i=0; i < qMin(int(arr.size()), GAME_COLS * GAME_ROWS); ++i) {
+                int shapeId = arr[i].toInt();
+                if (shapeId < 0 || shapeId > GARBAGE_COLOR) shapeId = 0;
+                state.board.setCell(i % GAME_COLS, i / GAME_COLS, shapeId);
             }
-            update();
         }
-        else if (type == "attack") addGarbageLines(root["lines"].toInt());
-        else if (type == "game_over") {
-            isGameOver = true;
-            timer->stop();
-            bgmPlayer->stop(); // 遊戲結束停音樂
-            QMessageBox::information(this, "結果", "你贏了！對手輸了。");
-            onBackClicked();
+        state.hold = root["hold"].toInt();
+        QJsonArray nextArr = root["next_queue"].toArray();
+        state.nextCount = qMin(int(nextArr.size()), NEXT_QUEUE_SIZE);
+        for (int i = 0; i < state.nextCount; i++) state.next[i] = nextArr[i].toInt();
+        applyOpponentState(state);
+    }
+    else if (type == "attack") addGarbageLines(root["lines"].toInt());
+    else if (type == "game_over") {
+        if (root["result"].toString() == "lose") onServerDeclaredLoss();
+        else onOpponentGameOver();
+    }
+}
+
+void MainWindow::handleBinaryFrame(int type, const uint8_t *data, int size)
+{
+    switch (type) {
+    case Protocol::MSG_GAME_STATE: {
+        Protocol::GameState state;
+        if (Protocol::decodeGameState(data, size, state)) applyOpponentState(state);
+        break;
+    }
+    case Protocol::MSG_ATTACK: {
+        int lines = 0;
+        if (Protocol::decodeAttack(data, size, lines)) addGarbageLines(lines);
+        break;
+    }
+    case Protocol::MSG_GAME_OVER:
+        if (Protocol::decodeGameOver(data, size) == Protocol::RESULT_YOU_LOST) onServerDeclaredLoss();
+        else onOpponentGameOver();
+        break;
+    case Protocol::MSG_KEYFRAME: {
+        Protocol::Keyframe keyframe;
+        if (!Protocol::decodeKeyframe(data, size, keyframe)) break;
+        opponentLocked = keyframe.board;
+        opponentPiece = keyframe.piece;
+        opponentHold = keyframe.hold;
+        opponentNextPieces.clear();
+        for (int i = 0; i < keyframe.nextCount; i++) opponentNextPieces.append(keyframe.next[i]);
+        opponentSeq = keyframe.seq + 1;
+        opponentSynced = true;
+        keyframeRequested = false;
+        refreshOpponentBoard(true);
+        break;
+    }
+    case Protocol::MSG_PIECE: {
+        uint16_t seq;
+        TetrisPiece piece;
+        if (!Protocol::decodePiece(data, size, seq, piece) || !acceptOpponentSeq(seq)) break;
+        opponentPiece = piece;
+        refreshOpponentBoard(false);
+        break;
+    }
+    case Protocol::MSG_PLACE: {
+        Protocol::Placement placement;
+        if (!Protocol::decodePlacement(data, size, placement) || !acceptOpponentSeq(placement.seq)) break;
+        Protocol::applyPlacement(opponentLocked, placement);
+        opponentPiece.shape = 0;
+        refreshOpponentBoard(true);
+        break;
+    }
+    case Protocol::MSG_QUEUE: {
+        Protocol::QueueUpdate queue;
+        if (!Protocol::decodeQueue(data, size, queue) || !acceptOpponentSeq(queue.seq)) break;
+        opponentHold = queue.hold;
+        opponentNextPieces.clear();
+        for (int i = 0; i < queue.nextCount; i++) opponentNextPieces.append(queue.next[i]);
+        updateOpponentPanels();
+        break;
+    }
+    case Protocol::MSG_KEYFRAME_REQUEST:
+        keyframePending = true;
+        queueGameState();
+        break;
+    case Protocol::MSG_GARBAGE: {
+        // 洞的位置由 Server 決定，兩邊盤面才會一樣
+        Protocol::Garbage garbage;
+        if (!isAuthoritative || !Protocol::decodeGarbage(data, size, garbage)) break;
+        replay.recordGarbage(replayFrame(), garbage.count, garbage.holes);
+        engine.addGarbageLines(garbage.count, garbage.holes);
+        // Server 是在處理完 ackInput 時塞的；之後的輸入還在路上的話，要在那個時間點插進去再重跑
+        if (advanceServerState(garbage.ackInput)) {
+            serverEngine.addGarbageLines(garbage.count, garbage.holes);
+            reconcile();
+        }
+        updateMyBoard();
+        break;
+    }
+    case Protocol::MSG_SYNC: {
+        Protocol::Sync sync;
+        if (isAuthoritative && Protocol::decodeSync(data, size, sync)) applySync(sync);
+        break;
+    }
+    case Protocol::MSG_PING: {
+        // Server 也會量我們：收到的時間與回的時間幾乎一樣，直接填同一個
+        Protocol::Pong pong;
+        if (!Protocol::decodePing(data, size, pong.id, pong.t0)) break;
+        pong.t1 = pong.t2 = profiler.now() / 1000;
+        uint8_t frame[Protocol::MAX_PONG_FRAME];
+        writeFrame(frame, Protocol::encodePong(pong, frame));
+        socket->flush();
+        break;
+    }
+    case Protocol::MSG_PONG: {
+        Protocol::Pong pong;
+        if (serverPings && Protocol::decodePong(data, size, pong)) {
+            serverClock.addSample(pong.t0, pong.t1, pong.t2, profiler.now() / 1000);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void MainWindow::applyOpponentState(const Protocol::GameState &state)
+{
+    opponentBoard = state.board; // 已經含落下中的方塊
+    opponentFalling.shape = 0;
+    opponentRevision++;
+    opponentHold = state.hold;
+    opponentNextPieces.clear();
+    for (int i = 0; i < state.nextCount; i++) opponentNextPieces.append(state.next[i]);
+    updateOpponentBoard();
+    updateOpponentPanels();
+}
+
+bool MainWindow::acceptOpponentSeq(uint16_t seq)
+{
+    if (opponentSynced && seq == opponentSeq) {
+        opponentSeq++;
+        return true;
+    }
+
+    // 缺號 (或還沒收到第一個 keyframe)：丟掉差異，請對方送完整盤面
+    opponentSynced = false;
+    if (!keyframeRequested && socket->state() == QAbstractSocket::ConnectedState) {
+        uint8_t frame[Protocol::HEADER_SIZE];
+        writeFrame(frame, Protocol::encodeKeyframeRequest(frame));
+        socket->flush();
+        keyframeRequested = true;
+    }
+    return false;
+}
+
+// 只有 keyframe / 放置會改到已鎖定的盤面，單純移動方塊不用重畫快取
+void MainWindow::refreshOpponentBoard(bool lockedChanged)
+{
+    opponentFalling = opponentPiece;
+    if (lockedChanged) {
+        opponentBoard = opponentLocked;
+        opponentRevision++;
+        updateOpponentBoard();
+        updateOpponentPanels(); // keyframe 也帶了 HOLD / NEXT
+    } else {
+        updateOpponentPiece();
+    }
+}
+
+void MainWindow::onOpponentGameOver()
+{
+    isGameOver = true;
+    timer->stop();
+    bgmPlayer->stop(); // 遊戲結束停音樂
+    QMessageBox::information(this, "結果", "你贏了！對手輸了。");
+    onBackClicked();
+}
+
+// --- 電腦對手 ---
+
+void MainWindow::cpuStep()
+{
+    if (!isCpuMode || isPaused || isGameOver) return;
+
+    if (!cpuPlan.found || cpuPlanPos >= cpuPlan.inputCount) {
+        if (CPU_LEVELS[cpuDifficulty].beam.beamWidth > 0) {
+            requestCpuPlan(); // 結果回來之前電腦不操作 (重力照樣在跑)
+            return;
         }
+        cpuPlan = bot.plan(cpuEngine);
+        cpuPlanPos = 0;
+        if (!cpuPlan.found) dropCpuPiece();
+    }
+
+    TetrisPiece before = cpuEngine.piece();
+    bool couldHold = cpuEngine.canHold();
+    LockResult result;
+    if (cpuEngine.applyInput(cpuPlan.inputs[cpuPlanPos++], result)) finishCpuLock(result);
+    else if (couldHold && !cpuEngine.canHold()) cpuTicker.pieceSpawned(cpuEngine); // HOLD 換了方塊
+    else if (!samePiece(before, cpuEngine.piece())) cpuTicker.pieceMoved(cpuEngine);
+    if (cpuEngine.isGameOver()) {
+        onOpponentGameOver();
+        return;
+    }
+    refreshCpuView();
+}
+
+// 電腦跟玩家一樣有重力與鎖定延遲，跟著玩家的 tick 一起跑
+void MainWindow::cpuTick()
+{
+    TickResult step = cpuTicker.tick(cpuEngine);
+    if (step.locked) finishCpuLock(step.lock);
+    if (cpuEngine.isGameOver()) {
+        onOpponentGameOver();
+        return;
     }
+    if (step.locked || step.gravitySteps > 0) refreshCpuView();
+}
+
+void MainWindow::finishCpuLock(const LockResult &result)
+{
+    resetCpuPlan(); // 照計畫放完或被鎖定延遲先鎖住，都要替下一顆重新找落點
+    cpuTicker.pieceSpawned(cpuEngine);
+    if (result.attack > 0) addGarbageLines(result.attack);
+}
+
+void MainWindow::requestCpuPlan()
+{
+    if (cpuThinking) return;
+    cpuThinking = true;
+
+    int requestId = ++cpuRequestId;
+    TetrisEngine snapshot = cpuEngine;
+    BeamSettings settings = CPU_LEVELS[cpuDifficulty].beam;
+    BotWorker *worker = botWorker;
+    QMetaObject::invokeMethod(worker, [worker, requestId, snapshot, settings]() {
+        worker->think(requestId, snapshot, settings);
+    }, Qt::QueuedConnection);
+}
+
+void MainWindow::onCpuPlanReady(int requestId, const BotPlan &plan)
+{
+    if (requestId != cpuRequestId || !isCpuMode) return;
+    cpuThinking = false;
+    cpuPlan = plan;
+    cpuPlanPos = 0;
+    if (!cpuPlan.found) dropCpuPiece();
+}
+
+// 找不到落點 (例如方塊被垃圾行推出盤面太多)：直接硬降，讓 engine 決定是不是已經輸了，
+// 不然電腦會一直停在原地，對局永遠不會結束
+void MainWindow::dropCpuPiece()
+{
+    cpuPlan.found = true;
+    cpuPlan.useHold = false;
+    cpuPlan.inputCount = 1;
+    cpuPlan.inputs[0] = INPUT_HARD_DROP;
+    cpuPlanPos = 0;
+}
+
+// 盤面被外力改變 (垃圾行、重新開局)：丟掉目前的計畫與還在算的結果
+void MainWindow::resetCpuPlan()
+{
+    cpuPlan.found = false;
+    cpuPlanPos = 0;
+    cpuRequestId++;
+    cpuThinking = false;
+}
+
+void MainWindow::refreshCpuView()
+{
+    opponentFalling = cpuEngine.piece();
+    if (cpuViewRevision != cpuEngine.revision()) {
+        cpuViewRevision = cpuEngine.revision();
+        opponentBoard = cpuEngine.board();
+        opponentRevision++;
+        updateOpponentBoard();
+    } else {
+        updateOpponentPiece();
+    }
+
+    QVector<int> next;
+    for (int i = 0; i < SENT_NEXT_COUNT; i++) next.append(cpuEngine.nextPiece(i));
+    if (next != opponentNextPieces || opponentHold != cpuEngine.heldShape()) {
+        opponentHold = cpuEngine.heldShape();
+        opponentNextPieces = next;
+        updateOpponentPanels();
+    }
+}
+
+void MainWindow::onServerDeclaredLoss()
+{
+    isGameOver = true;
+    timer->stop();
+    bgmPlayer->stop();
+    QMessageBox::information(this, "Game Over", "你輸了！");
+    onBackClicked();
+}
+
+// SYNC 是 Server 處理完 ackInput 時的狀態：跟同一點的基準比，不同就換掉基準，
+// 再把之後還在路上的輸入重跑一次 (輸入在路上的時候也照樣校正)
+void MainWindow::applySync(const Protocol::Sync &sync)
+{
+    if (!advanceServerState(sync.ackInput)) return;
+
+    const TetrisBoard &board = serverEngine.board();
+    bool same = std::memcmp(board.rows, sync.board.rows, sizeof(board.rows)) == 0
+             && std::memcmp(board.colors, sync.board.colors, sizeof(board.colors)) == 0
+             && samePiece(serverEngine.piece(), sync.piece)
+             && serverEngine.heldShape() == sync.hold && serverEngine.canHold() == sync.canHold;
+    if (same) return;
+
+    corrections++;
+    serverEngine.correct(sync.board, sync.piece, sync.hold, sync.canHold);
+    reconcile();
+}
+
+// 基準往前推到 ackInput (Server 已經處理過的輸入從 unackedInputs 移掉)；序號不合理回傳 false
+bool MainWindow::advanceServerState(uint16_t ackInput)
+{
+    int count = uint16_t(ackInput - serverAck);
+    if (count > unackedInputs.size()) return false; // 不可能確認還沒送出的輸入
+
+    LockResult result;
+    for (int i = 0; i < count; i++) serverEngine.applyInput(static_cast<TetrisInput>(unackedInputs[i]), result);
+    unackedInputs.remove(0, count);
+    serverAck = ackInput;
+    return true;
+}
+
+// 從基準重跑還沒確認的輸入得到新的預測，跟目前的不一樣才換掉；換了回傳 true
+bool MainWindow::reconcile()
+{
+    TetrisEngine predicted = serverEngine;
+    LockResult result;
+    for (uint8_t input : unackedInputs) predicted.applyInput(static_cast<TetrisInput>(input), result);
+
+    uint8_t next[TetrisEngine::STATE_SIZE];
+    uint8_t current[TetrisEngine::STATE_SIZE];
+    predicted.saveState(next);
+    engine.saveState(current);
+    if (std::memcmp(next, current, sizeof(next)) == 0) return false;
+
+    TetrisPiece before = engine.piece();
+    engine.loadState(next, sizeof(next)); // 整個狀態換掉 (含分數與亂數串流)，盤面快取也會重畫
+    if (engine.piece().shape != before.shape) ticker.pieceSpawned(engine);
+    else if (!samePiece(before, engine.piece())) ticker.pieceMoved(engine);
+    replay.recordSnapshot(replayFrame(), engine); // 校正沒辦法用輸入重現，直接存完整狀態
+    updateMyBoard();
+    updateMyPanels();
+    return true;
 }
 
 void MainWindow::sendPlayerName()
@@ -343,44 +816,262 @@ void MainWindow::sendPlayerName()
     QJsonObject root;
     root["type"] = "player_info";
     root["name"] = localPlayerName;
-    socket->write(QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n");
+    root["proto"] = Protocol::PROTOCOL_VERSION; // 告訴 Server 我們支援二進位封包
+    writeLine(root);
+    socket->flush();
+}
+
+// 每個輸入都寫進重播檔 (在套用之前呼叫)。
+// 權威模式：輸入先照樣在本地套用，同時記下來，跟狀態一樣每個 tick 合併成一個 MSG_INPUT
+void MainWindow::recordInput(TetrisInput input)
+{
+    replay.recordInput(replayFrame(), input, engine);
+    if (!isAuthoritative) return;
+    if (pendingInputs.isEmpty()) pendingFirstInput = inputSeq;
+    pendingInputs.append(input);
+    unackedInputs.append(input);
+    inputSeq++;
+    queueGameState();
+    if (pendingInputs.size() >= Protocol::MAX_INPUT_BATCH) flushGameState();
+}
+
+void MainWindow::sendInputs()
+{
+    if (pendingInputs.isEmpty()) return;
+    uint8_t frame[Protocol::MAX_INPUT_FRAME];
+    writeFrame(frame, Protocol::encodeInputs(pendingFirstInput, pendingInputs.constData(), pendingInputs.size(), frame));
     socket->flush();
+    pendingInputs.clear();
+}
+
+// 重播檔放在 AppData/replays/，檔名是開局時間
+void MainWindow::openReplay()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/replays";
+    QDir().mkpath(dir);
+    QString path = dir + "/" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".tetr";
+    if (!replay.open(QFile::encodeName(path).constData(), matchSeed)) {
+        qDebug() << "Cannot record replay to" << path;
+    }
+}
+
+void MainWindow::closeReplay()
+{
+    if (!replay.isOpen()) return;
+    replay.recordEnd(replayFrame());
+    replay.close();
+}
+
+uint32_t MainWindow::replayFrame() const
+{
+    return ticker.frame(); // Replay::FRAMES_PER_SECOND == TICKS_PER_SECOND
+}
+
+void MainWindow::sendPing()
+{
+    if (!serverPings || socket->state() != QAbstractSocket::ConnectedState) return;
+    uint8_t frame[Protocol::MAX_PING_FRAME];
+    writeFrame(frame, Protocol::encodePing(serverClock.nextPingId(), profiler.now() / 1000, frame));
+    socket->flush(); // 不等事件迴圈，t0 才準
+}
+
+void MainWindow::writeFrame(const uint8_t *frame, int size)
+{
+    socket->write(reinterpret_cast<const char*>(frame), size);
+    framesSent++;
+    checkSendLimit();
+}
+
+void MainWindow::writeLine(const QJsonObject &root)
+{
+    // 使用 Compact 模式，確保 JSON 是一整行
+    socket->write(QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n");
+    framesSent++;
+    checkSendLimit();
+}
+
+// Server 完全沒在讀：斷線 (排到事件迴圈再斷，不會在送到一半的時候觸發 disconnected)
+void MainWindow::checkSendLimit()
+{
+    if (socket->bytesToWrite() <= sendDisconnectBytes) return;
+    QMetaObject::invokeMethod(socket, &QAbstractSocket::abort, Qt::QueuedConnection);
+}
+
+// 狀態變化不立刻送出：距離上次送出超過一個 tick 就馬上送，否則排到下一個 tick，
+// 中間的變化全部合併成一次 (按住方向鍵的自動連發不會再每次都 write + flush)
+void MainWindow::queueGameState()
+{
+    if (!isOnlineMode) return;
+    if (stateDirty) {
+        framesCoalesced++;
+        return;
+    }
+    stateDirty = true;
+
+    qint64 elapsed = lastStateSend.isValid() ? lastStateSend.elapsed() : sendIntervalMs;
+    if (elapsed >= sendIntervalMs) flushGameState();
+    else sendTimer->start(int(sendIntervalMs - elapsed));
+}
+
+void MainWindow::flushGameState()
+{
+    sendTimer->stop();
+    if (!stateDirty) return;
+    // Server 還沒讀完之前送的：這次先不送，變化留著跟下一次合併 (權威模式的輸入不能丟，照送)
+    if (!isAuthoritative && socket->bytesToWrite() > SEND_BUDGET_BYTES) {
+        framesDeferred++;
+        sendTimer->start(sendIntervalMs);
+        return;
+    }
+    stateDirty = false;
+    lastStateSend.start();
+    sendGameState();
 }
 
 void MainWindow::sendGameState()
 {
     if (!isOnlineMode || socket->state() != QAbstractSocket::ConnectedState) return;
+    FrameProfiler::Span span(profiler, "sendGameState");
 
-    QJsonObject root;
-    root["type"] = "game_state";
+    if (isAuthoritative) {
+        sendInputs(); // 對手畫面由 Server 產生
+        return;
+    }
+
+    if (wireVersion >= 2) {
+        sendStateDelta();
+        return;
+    }
 
-    QVector<int> tempBoard = board;
-    QVector<QPoint> coords = getShapeCoords(currentShape, currentRotation);
-    for(const QPoint &p : coords) {
-        int x = currentX + p.x();
-        int y = currentY + p.y();
+    Protocol::GameState state;
+    state.board = engine.board();
+    const TetrisPiece &piece = engine.piece();
+    for(const auto &cell : SHAPE_CELLS[piece.shape][piece.rotation]) {
+        int x = piece.x + cell[0];
+        int y = piece.y + cell[1];
         if (x >= 0 && x < GAME_COLS && y >= 0 && y < GAME_ROWS) {
-            tempBoard[y * GAME_COLS + x] = currentShape;
+            state.board.setCell(x, y, piece.shape);
         }
     }
+    state.hold = engine.heldShape();
+    state.nextCount = SENT_NEXT_COUNT;
+    for(int i=0; i < state.nextCount; i++) state.next[i] = engine.nextPiece(i);
+
+    if (wireVersion >= 1) {
+        uint8_t frame[Protocol::MAX_GAME_STATE_FRAME];
+        writeFrame(frame, Protocol::encodeGameState(state, frame));
+        socket->flush();
+        return;
+    }
+
+    QJsonObject root;
+    root["type"] = "game_state";
     QJsonArray boardArr;
-    for (int val : tempBoard) boardArr.append(val);
+    for (int y = 0; y < GAME_ROWS; y++) {
+        for (int x = 0; x < GAME_COLS; x++) boardArr.append(state.board.cell(x, y));
+    }
     root["board"] = boardArr;
-    root["hold"] = heldShape;
+    root["hold"] = state.hold;
     QJsonArray nextArr;
-    for(int i=0; i < qMin(nextPieces.size(), 3); i++) {
-        nextArr.append(nextPieces[i]);
-    }
+    for(int i=0; i < state.nextCount; i++) nextArr.append(state.next[i]);
     root["next_queue"] = nextArr;
-    socket->write(QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n");
+    writeLine(root);
+    socket->flush();
+}
+
+// 只送跟上次比有變的部分：方塊位置、HOLD/NEXT；定期或對方要求時改送 keyframe
+void MainWindow::sendStateDelta()
+{
+    if (keyframePending || updatesSinceKeyframe >= Protocol::KEYFRAME_INTERVAL) {
+        sendKeyframe();
+        return;
+    }
+
+    uint8_t frame[Protocol::MAX_DELTA_FRAME];
+
+    bool queueChanged = engine.heldShape() != lastSentHold;
+    for (int i = 0; i < SENT_NEXT_COUNT; i++) queueChanged |= engine.nextPiece(i) != lastSentNext[i];
+    if (queueChanged) {
+        Protocol::QueueUpdate queue;
+        queue.seq = sendSeq++;
+        queue.hold = lastSentHold = engine.heldShape();
+        queue.nextCount = SENT_NEXT_COUNT;
+        for (int i = 0; i < SENT_NEXT_COUNT; i++) queue.next[i] = lastSentNext[i] = engine.nextPiece(i);
+        writeFrame(frame, Protocol::encodeQueue(queue, frame));
+        updatesSinceKeyframe++;
+    }
+
+    if (!samePiece(engine.piece(), lastSentPiece)) {
+        lastSentPiece = engine.piece();
+        writeFrame(frame, Protocol::encodePiece(sendSeq++, lastSentPiece, frame));
+        updatesSinceKeyframe++;
+    }
+    socket->flush();
+}
+
+void MainWindow::sendKeyframe()
+{
+    Protocol::Keyframe keyframe;
+    keyframe.seq = sendSeq++;
+    keyframe.board = engine.board();
+    keyframe.piece = lastSentPiece = engine.piece();
+    keyframe.hold = lastSentHold = engine.heldShape();
+    keyframe.nextCount = SENT_NEXT_COUNT;
+    for (int i = 0; i < SENT_NEXT_COUNT; i++) keyframe.next[i] = lastSentNext[i] = engine.nextPiece(i);
+
+    uint8_t frame[Protocol::MAX_KEYFRAME_FRAME];
+    writeFrame(frame, Protocol::encodeKeyframe(keyframe, frame));
     socket->flush();
+
+    keyframePending = false;
+    updatesSinceKeyframe = 0;
+}
+
+void MainWindow::sendPlacement(const LockResult &result)
+{
+    if (!isOnlineMode || wireVersion < 2 || socket->state() != QAbstractSocket::ConnectedState) return;
+    if (keyframePending) return; // 接下來的 keyframe 已經包含這次鎖定
+    if (socket->bytesToWrite() > SEND_BUDGET_BYTES) {
+        keyframePending = true; // 塞車：這次鎖定併進之後的 keyframe
+        framesDeferred++;
+        return;
+    }
+
+    Protocol::Placement placement;
+    placement.seq = sendSeq++;
+    placement.piece = result.placed;
+    placement.clearedRows = result.clearedRows;
+
+    uint8_t frame[Protocol::MAX_DELTA_FRAME];
+    writeFrame(frame, Protocol::encodePlacement(placement, frame));
+    updatesSinceKeyframe++;
+    lastSentPiece.shape = 0; // 新方塊一定要再送一次
 }
 
 void MainWindow::sendAttack(int lines)
 {
     if (!isOnlineMode || socket->state() != QAbstractSocket::ConnectedState) return;
+    if (wireVersion >= 1) {
+        uint8_t frame[Protocol::HEADER_SIZE + 1];
+        writeFrame(frame, Protocol::encodeAttack(lines, frame));
+        socket->flush();
+        return;
+    }
     QJsonObject root; root["type"] = "attack"; root["lines"] = lines;
-    socket->write(QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n");
+    writeLine(root);
+    socket->flush();
+}
+
+void MainWindow::sendGameOver()
+{
+    if (!isOnlineMode || socket->state() != QAbstractSocket::ConnectedState) return;
+    if (wireVersion >= 1) {
+        uint8_t frame[Protocol::HEADER_SIZE];
+        writeFrame(frame, Protocol::encodeGameOver(frame));
+    } else {
+        QJsonObject root; root["type"] = "game_over";
+        writeLine(root);
+    }
     socket->flush();
 }
 
@@ -388,208 +1079,314 @@ void MainWindow::sendAttack(int lines)
 
 void MainWindow::startGame()
 {
-    board.fill(0);
-    opponentBoard.fill(0);
+    opponentBoard.clear();
+    opponentFalling = TetrisPiece{0, 0, 0, 0};
+    opponentRevision++;
     opponentNextPieces.clear();
     opponentHold = 0;
 
-    score = 0;
-    level = 1;
-    dropSpeed = 1000;
+    opponentLocked.clear();
+    opponentPiece = TetrisPiece{0, 0, 0, 0};
+    opponentSynced = false;
+    keyframeRequested = false;
+    sendSeq = 0;
+    updatesSinceKeyframe = 0;
+    keyframePending = true;
+    lastSentPiece = TetrisPiece{0, 0, 0, 0};
+    lastSentHold = -1;
+
+    stateDirty = false;
+    sendTimer->stop();
+    lastStateSend.invalidate();
+    framesSent = 0;
+    framesCoalesced = 0;
+    framesDeferred = 0;
+
+    inputSeq = 0;
+    pendingInputs.clear();
+    unackedInputs.clear();
+    serverAck = uint16_t(inputSeq - 1); // 還沒有任何輸入被確認
+    corrections = 0;
+
     isGameOver = false;
     isPaused = false;
 
     btnBack->show();
     btnBack->raise();
 
-    bag.clear();
-    nextPieces.clear();
-    refillBag();
-    refillBag();
-    while(nextPieces.size() < 5) {
-        if(bag.isEmpty()) refillBag();
-        nextPieces.append(bag.takeFirst());
+    // 線上用 Server 給的種子 (跟對手、Server 一樣的方塊順序)，單人練習每場抽一個新的
+    if (!isOnlineMode) matchSeed = QRandomGenerator::global()->generate();
+    engine.reset(matchSeed);
+    serverEngine.reset(matchSeed);
+    ticker.reset();
+    ticker.pieceSpawned(engine);
+    pendingKeys.clear();
+    keysAwaitingPaint.clear();
+    profiler.reset();
+    fallOffset = 0;
+    inputLatencyTotal = 0;
+    inputLatencyCount = 0;
+    inputLatencyMax = 0;
+    openReplay();
+
+    if (isCpuMode) {
+        // 電腦拿同一個種子，兩邊的方塊順序一樣
+        cpuEngine.reset(matchSeed);
+        cpuTicker.reset();
+        cpuTicker.pieceSpawned(cpuEngine);
+        resetCpuPlan();
+        cpuTimer->start(CPU_LEVELS[cpuDifficulty].inputInterval);
+        refreshCpuView();
     }
 
-    canHold = true;
-    heldShape = 0;
-
     // [新增] 播放音樂
     if(bgmPlayer->playbackState() != QMediaPlayer::PlayingState) {
         bgmPlayer->play();
     }
 
-    spawnPiece();
-    timer->start(dropSpeed);
+    tickBase = 0;
+    gameClock.start();
+    timer->start();
 
     if(isOnlineMode) sendGameState();
     update();
 }
 
-void MainWindow::spawnPiece() {
-    while (nextPieces.size() < 5) {
-        if (bag.isEmpty()) refillBag();
-        nextPieces.append(bag.takeFirst());
+void MainWindow::handleGameOver()
+{
+    isGameOver = true;
+    timer->stop();
+    bgmPlayer->stop(); // 遊戲結束停音樂
+
+    if(isOnlineMode && isAuthoritative) {
+        // 勝負由 Server 判定：先把最後的輸入送出去，等 Server 的 game_over
+        flushGameState();
+        update();
+    } else if(isOnlineMode) {
+        sendGameOver();
+        QMessageBox::information(this, "Game Over", "你輸了！");
+        onBackClicked();
+    } else {
+        QMessageBox::information(this, "Game Over", isCpuMode ? "你輸了！" : "遊戲結束！");
+        onBackClicked();
     }
+}
 
-    currentShape = nextPieces.takeFirst();
-    canHold = true;
-    currentRotation = 0;
-    currentX = GAME_COLS / 2 - 1;
-    currentY = 0;
+qint64 MainWindow::wallTick() const
+{
+    return tickBase + gameClock.elapsed() * TICKS_PER_SECOND / 1000;
+}
 
-    if (!tryMove(currentX, currentY, currentRotation)) {
-        isGameOver = true;
-        timer->stop();
-        bgmPlayer->stop(); // 遊戲結束停音樂
+// 照真實經過的時間補跑 tick；計時器晚到只會讓這次多跑幾個 tick，遊戲節奏不受影響
+void MainWindow::gameLoop() {
+    if (isPaused || isGameOver || isWaitingForOpponent) return;
+    FrameProfiler::Span span(profiler, "gameLoop");
 
-        if(isOnlineMode) {
-            QJsonObject root; root["type"] = "game_over";
-            socket->write(QJsonDocument(root).toJson(QJsonDocument::Compact) + "\n");
-            QMessageBox::information(this, "Game Over", "你輸了！");
-            onBackClicked();
-        } else {
-            QMessageBox::information(this, "Game Over", "遊戲結束！");
-            onBackClicked();
-        }
+    qint64 behind = wallTick() - qint64(ticker.frame());
+    if (behind > MAX_CATCHUP_TICKS) {
+        // 事件迴圈卡太久 (例如拖曳視窗)：多的時間直接丟掉，不要一口氣掉好幾格
+        tickBase -= behind - MAX_CATCHUP_TICKS;
+        behind = MAX_CATCHUP_TICKS;
+    }
+    for (; behind > 0 && !isGameOver; --behind) simulateTick();
+    if (isGameOver || !isGameMode) return;
+
+    // 畫面內插：方塊照重力累加的進度往下滑，只在像素位置有變時重畫
+    int offset = int(ticker.fallProgress(engine) * CELL_SIZE);
+    if (offset != fallOffset) {
+        fallOffset = offset;
+        updateMyPiece();
+    }
+
+    if (showHud && profiler.now() - lastHudNs >= HUD_REFRESH_NS) {
+        lastHudNs = profiler.now();
+        update(screenLayout().hud);
     }
-    if(isOnlineMode) sendGameState();
 }
 
-void MainWindow::holdPiece()
+void MainWindow::simulateTick()
 {
-    if (isGameOver || isPaused || !canHold) return;
+    // 上一個 tick 之後按的鍵先套用，再跑重力與鎖定
+    for (int i = 0; i < pendingKeys.size() && !isGameOver; ++i) {
+        qint64 latency = qMax<qint64>(0, qint64(ticker.frame()) - pendingKeys[i].tick);
+        inputLatencyTotal += quint64(latency);
+        inputLatencyCount++;
+        inputLatencyMax = qMax(inputLatencyMax, latency);
+
+        TetrisPiece before = engine.piece();
+        uint32_t revision = engine.revision();
+        int held = engine.heldShape();
+        applyKey(pendingKeys[i].key);
+        // 撞牆之類沒改變畫面的按鍵不算
+        if (!samePiece(before, engine.piece()) || revision != engine.revision() || held != engine.heldShape()) {
+            keysAwaitingPaint.append(pendingKeys[i].pressedNs);
+        }
+    }
+    pendingKeys.clear();
+    if (isGameOver) return;
+
+    TickResult step;
+    {
+        // 重力與鎖定延遲到期的鎖定 (含消行) 都在 engine 裡，這一段就是它們的時間
+        FrameProfiler::Span span(profiler, "tickGravityLock");
+        step = ticker.tick(engine, [this](TetrisInput input) { recordInput(input); });
+    }
+    if (step.locked) finishLock(step.lock);
+    else if (step.gravitySteps > 0) updateMyPiece();
+    if (isCpuMode && !isGameOver) cpuTick();
+}
 
-    if (heldShape == 0) {
-        heldShape = currentShape;
-        spawnPiece();
-    } else {
-        std::swap(currentShape, heldShape);
-        currentX = GAME_COLS / 2 - 1;
-        currentY = 0;
-        currentRotation = 0;
-        if (!tryMove(currentX, currentY, currentRotation)) {
-            isGameOver = true; timer->stop();
+// hard drop：落到底再鎖定 (消行在 engine 鎖定時一起做)
+void MainWindow::placePiece() {
+    LockResult result;
+    {
+        FrameProfiler::Span span(profiler, "placePiece");
+        while (engine.moveDown()) {}
+        result = engine.lockPiece();
+    }
+    finishLock(result);
+}
+
+// 方塊鎖定後的共同處理 (hard drop 或鎖定延遲到了)
+void MainWindow::finishLock(const LockResult &result) {
+    FrameProfiler::Span span(profiler, "lockFollowUp");
+    ticker.pieceSpawned(engine);
+    fallOffset = 0;
+    if (isOnlineMode && !isAuthoritative) sendPlacement(result);
+    if (result.linesCleared > 0) {
+        FrameProfiler::Span clearSpan(profiler, "lineClearEffects"); // 音效、攻擊與電腦的垃圾行
+        // [新增] 播放消除音效
+        clearSound->play();
+        if (isOnlineMode && !isAuthoritative && result.attack > 0) sendAttack(result.attack);
+        if (isCpuMode && result.attack > 0) {
+            cpuEngine.addGarbageLines(result.attack);
+            resetCpuPlan(); // 盤面變了，重新找落點
+            refreshCpuView();
         }
     }
-    canHold = false;
-    update();
-    if(isOnlineMode) sendGameState();
+    if (result.toppedOut) {
+        handleGameOver();
+        return;
+    }
+    updateMyBoard();
+    updateMyPanels();
+    if(isOnlineMode) queueGameState();
 }
 
-void MainWindow::rotateWithWallKick()
+void MainWindow::addGarbageLines(int count)
 {
-    int nextRot = (currentRotation + 1) % 4;
-    if (tryMove(currentX, currentY, nextRot)) currentRotation = nextRot;
-    else if (tryMove(currentX + 1, currentY, nextRot)) { currentX += 1; currentRotation = nextRot; }
-    else if (tryMove(currentX - 1, currentY, nextRot)) { currentX -= 1; currentRotation = nextRot; }
-    update();
-    if(isOnlineMode) sendGameState();
+    // 洞還是由自己的串流決定，只是先看一下寫進重播檔
+    int holes[GAME_ROWS];
+    count = engine.peekGarbageHoles(count, holes);
+    replay.recordGarbage(replayFrame(), count, holes);
+    engine.addGarbageLines(count, holes);
+    keyframePending = true; // 垃圾行很少見，直接送完整盤面給對手
+    if (isOnlineMode) queueGameState();
+    updateMyBoard();
 }
 
-bool MainWindow::tryMove(int newX, int newY, int newRot) {
-    QVector<QPoint> coords = getShapeCoords(currentShape, newRot);
-    for (const QPoint &p : coords) {
-        int x = newX + p.x();
-        int y = newY + p.y();
-        if (x < 0 || x >= GAME_COLS || y >= GAME_ROWS) return false;
-        if (y >= 0) {
-            int idx = y * GAME_COLS + x;
-            if (idx >= 0 && idx < board.size() && board[idx] != 0) return false;
-        }
+// --- 繪圖事件 ---
+
+MainWindow::ScreenLayout MainWindow::screenLayout() const
+{
+    ScreenLayout layout;
+    int myBoardX;
+    int oppBoardX = 0;
+    int boardY = (height() - BOARD_PIXEL_H) / 2;
+    if (boardY < 50) boardY = 50;
+
+    bool twoBoards = isOnlineMode || isCpuMode;
+    if (!twoBoards) {
+        myBoardX = (width() - BOARD_PIXEL_W) / 2;
+    } else {
+        int gap = 300;
+        int totalWidth = BOARD_PIXEL_W * 2 + gap;
+        int startX = (width() - totalWidth) / 2;
+        myBoardX = startX;
+        oppBoardX = startX + BOARD_PIXEL_W + gap;
     }
-    return true;
+
+    // 外框的線多 1 px；文字區塊留足夠的高度蓋住字的上下緣
+    layout.myTitle = QRect(myBoardX, boardY - 40, BOARD_PIXEL_W + 1, 40);
+    layout.myBoard = QRect(myBoardX, boardY, BOARD_PIXEL_W + 1, BOARD_PIXEL_H + 1);
+    layout.myHold = QRect(myBoardX - 90, boardY, 81, 111);
+    layout.myNext = QRect(myBoardX + BOARD_PIXEL_W + 10, boardY, 81, 281);
+    layout.myStats = QRect(myBoardX, boardY + BOARD_PIXEL_H + 1, BOARD_PIXEL_W + 90, 40);
+    if (twoBoards) {
+        layout.oppTitle = QRect(oppBoardX, boardY - 40, BOARD_PIXEL_W + 1, 40);
+        layout.oppBoard = QRect(oppBoardX, boardY, BOARD_PIXEL_W + 1, BOARD_PIXEL_H + 1);
+        layout.oppHold = QRect(oppBoardX - 90, boardY, 81, 111);
+        layout.oppNext = QRect(oppBoardX + BOARD_PIXEL_W + 10, boardY, 81, 281);
+    }
+    // HUD 放在 Quit 按鈕下面：按鈕是子 widget，疊在同一塊的話會把 HUD 蓋掉
+    layout.hud = QRect(10, btnBack->geometry().bottom() + 10, 300, 124);
+    return layout;
 }
 
-void MainWindow::gameLoop() {
-    if (isPaused || isGameOver || isWaitingForOpponent) return;
-    if (tryMove(currentX, currentY + 1, currentRotation)) currentY++;
-    else if (!lockTimer->isActive()) lockTimer->start(500);
-    update();
+// 方塊 (往下延伸到 bottomY，含 ghost) 佔的像素範圍
+QRect MainWindow::pieceArea(const TetrisPiece &piece, int bottomY, const QRect &board) const
+{
+    if (piece.shape <= 0 || board.isEmpty()) return QRect();
+    const PieceMask &m = pieceMask(piece.shape, piece.rotation);
+    QRect area(QPoint(board.x() + (piece.x + m.minX) * CELL_SIZE, board.y() + (piece.y + m.minY) * CELL_SIZE),
+               QPoint(board.x() + (piece.x + m.maxX + 1) * CELL_SIZE, board.y() + (qMax(piece.y, bottomY) + m.maxY + 1) * CELL_SIZE));
+    return area.intersected(board);
 }
 
-void MainWindow::pieceDropped() {
-    if (tryMove(currentX, currentY + 1, currentRotation)) return;
-    placePiece();
+void MainWindow::updateMyPiece()
+{
+    const TetrisPiece &piece = engine.piece();
+    QRect area = pieceArea(piece, engine.ghostY(), screenLayout().myBoard);
+    update(area.united(lastMyPieceArea));
+    lastMyPieceArea = area;
 }
 
-void MainWindow::placePiece() {
-    QVector<QPoint> coords = getShapeCoords(currentShape, currentRotation);
-    for (const QPoint &p : coords) {
-        int x = currentX + p.x();
-        int y = currentY + p.y();
-        if (x >= 0 && x < GAME_COLS && y >= 0 && y < GAME_ROWS) {
-            int idx = y * GAME_COLS + x;
-            if (idx >= 0 && idx < board.size()) board[idx] = currentShape;
-        }
-    }
-    clearLines();
-    spawnPiece();
-    if(isOnlineMode) sendGameState();
+void MainWindow::updateMyBoard()
+{
+    ScreenLayout layout = screenLayout();
+    update(layout.myBoard);
+    lastMyPieceArea = pieceArea(engine.piece(), engine.ghostY(), layout.myBoard);
 }
 
-void MainWindow::clearLines() {
-    int linesCleared = 0;
-    for (int y = GAME_ROWS - 1; y >= 0; y--) {
-        bool full = true;
-        for (int x = 0; x < GAME_COLS; x++) {
-            if (board[y * GAME_COLS + x] == 0) { full = false; break; }
-        }
-        if (full) {
-            linesCleared++;
-            for (int k = y; k > 0; k--) {
-                for (int x = 0; x < GAME_COLS; x++) board[k * GAME_COLS + x] = board[(k - 1) * GAME_COLS + x];
-            }
-            for (int x = 0; x < GAME_COLS; x++) board[x] = 0;
-            y++;
-        }
-    }
-    if (linesCleared > 0) {
-        // [新增] 播放消除音效
-        clearSound->play();
+void MainWindow::updateMyPanels()
+{
+    ScreenLayout layout = screenLayout();
+    update(layout.myHold);
+    update(layout.myNext);
+    update(layout.myStats);
+}
 
-        int points[] = {0, 100, 300, 500, 800};
-        score += points[std::min(linesCleared, 4)] * level;
-        updateGameLevel();
-        if (isOnlineMode && linesCleared > 1) sendAttack(linesCleared - 1);
-    }
+void MainWindow::updateOpponentPiece()
+{
+    QRect area = pieceArea(opponentFalling, opponentFalling.y, screenLayout().oppBoard);
+    update(area.united(lastOppPieceArea));
+    lastOppPieceArea = area;
 }
 
-void MainWindow::addGarbageLines(int count)
+void MainWindow::updateOpponentBoard()
 {
-    if(count <= 0) return;
-    if(count >= GAME_ROWS) count = GAME_ROWS - 1;
-    for (int y = 0; y < GAME_ROWS - count; y++) {
-        for (int x = 0; x < GAME_COLS; x++) board[y * GAME_COLS + x] = board[(y + count) * GAME_COLS + x];
-    }
-    for (int y = GAME_ROWS - count; y < GAME_ROWS; y++) {
-        int hole = std::rand() % GAME_COLS;
-        for (int x = 0; x < GAME_COLS; x++) {
-            board[y * GAME_COLS + x] = (x == hole) ? 0 : 8;
-        }
-    }
-    if (!tryMove(currentX, currentY, currentRotation)) currentY -= count;
-    update();
+    ScreenLayout layout = screenLayout();
+    update(layout.oppBoard);
+    lastOppPieceArea = pieceArea(opponentFalling, opponentFalling.y, layout.oppBoard);
 }
 
-void MainWindow::updateGameLevel() {
-    int newLevel = (score / 1000) + 1;
-    if (newLevel > level) {
-        level = newLevel;
-        dropSpeed = std::max(100, 1000 - (level - 1) * 100);
-        timer->setInterval(dropSpeed);
-    }
+void MainWindow::updateOpponentPanels()
+{
+    ScreenLayout layout = screenLayout();
+    update(layout.oppHold);
+    update(layout.oppNext);
 }
 
-// --- 繪圖事件 ---
 void MainWindow::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event);
+    qint64 paintStart = profiler.now();
     QPainter painter(this);
+    const QRegion &dirty = event->region();
 
     if (menuWidget) menuWidget->resize(width(), height());
+    if (tileAtlas.isNull() || tileAtlas.devicePixelRatio() != devicePixelRatioF()) buildTileAtlas();
 
-    painter.fillRect(rect(), QColor(30, 30, 30));
+    painter.fillRect(event->rect(), QColor(30, 30, 30));
 
     if (!isGameMode) {
         return;
@@ -597,71 +1394,135 @@ void MainWindow::paintEvent(QPaintEvent *event)
 
     if (isWaitingForOpponent) {
         painter.setPen(Qt::white);
-        QFont f = painter.font(); f.setPointSize(24); painter.setFont(f);
+        painter.setFont(messageFont);
         painter.drawText(rect(), Qt::AlignCenter, "等待對手連線 (Waiting for Opponent)...");
         return;
     }
 
-    int myBoardX;
-    int oppBoardX = 0;
-    int boardY = (height() - BOARD_PIXEL_H) / 2;
-    if (boardY < 50) boardY = 50;
-
-    if (!isOnlineMode) {
-        myBoardX = (width() - BOARD_PIXEL_W) / 2;
-    } else {
-        int gap = 300;
-        int totalWidth = BOARD_PIXEL_W * 2 + gap;
-        int startX = (width() - totalWidth) / 2;
-        myBoardX = startX;
-        oppBoardX = startX + BOARD_PIXEL_W + gap;
-    }
+    // 只畫跟這次要重畫的範圍有交集的區塊 (painter 本身也已經被裁到這個範圍)
+    ScreenLayout layout = screenLayout();
+    int myBoardX = layout.myBoard.x();
+    int oppBoardX = layout.oppBoard.x();
+    int boardY = layout.myBoard.y();
 
     // YOU
-    painter.setPen(Qt::white);
-    QFont titleFont = painter.font();
-    titleFont.setBold(true); titleFont.setPointSize(16); painter.setFont(titleFont);
-    painter.drawText(myBoardX, boardY - 10, localPlayerName);
+    if (dirty.intersects(layout.myTitle)) {
+        painter.setPen(Qt::white);
+        painter.setFont(titleFont);
+        painter.drawText(myBoardX, boardY - 10, localPlayerName);
+    }
 
-    QString stats = QString("SCORE: %1  LEVEL: %2").arg(score).arg(level);
-    QFont statFont = painter.font(); statFont.setPointSize(12); painter.setFont(statFont);
-    painter.drawText(myBoardX, boardY + BOARD_PIXEL_H + 30, stats);
+    if (dirty.intersects(layout.myStats)) {
+        QString stats = QString("SCORE: %1  LEVEL: %2").arg(engine.score()).arg(engine.level());
+        painter.setPen(Qt::white);
+        painter.setFont(statFont);
+        painter.drawText(myBoardX, boardY + BOARD_PIXEL_H + 30, stats);
+    }
 
-    drawBoard(painter, myBoardX, boardY, board, true);
+    if (dirty.intersects(layout.myBoard)) drawBoard(painter, myBoardX, boardY, engine.board(), true);
 
-    int myHoldX = myBoardX - 90;
-    drawQueue(painter, myHoldX, boardY, "HOLD", {heldShape}, canHold);
+    if (dirty.intersects(layout.myHold)) drawQueue(painter, layout.myHold.x(), boardY, "HOLD", {engine.heldShape()}, engine.canHold());
 
-    int myNextX = myBoardX + BOARD_PIXEL_W + 10;
-    drawQueue(painter, myNextX, boardY, "NEXT", nextPieces, true);
+    if (dirty.intersects(layout.myNext)) {
+        QList<int> myNext;
+        for (int i = 0; i < NEXT_QUEUE_SIZE; i++) myNext.append(engine.nextPiece(i));
+        drawQueue(painter, layout.myNext.x(), boardY, "NEXT", myNext, true);
+    }
 
     // OPPONENT
-    if (isOnlineMode) {
-        painter.setPen(Qt::white);
-        painter.setFont(titleFont);
-        painter.drawText(oppBoardX, boardY - 10, opponentName);
+    if (isOnlineMode || isCpuMode) {
+        if (dirty.intersects(layout.oppTitle)) {
+            painter.setPen(Qt::white);
+            painter.setFont(titleFont);
+            painter.drawText(oppBoardX, boardY - 10, opponentName);
+        }
 
-        drawBoard(painter, oppBoardX, boardY, opponentBoard, false);
+        if (dirty.intersects(layout.oppBoard)) drawBoard(painter, oppBoardX, boardY, opponentBoard, false);
 
-        int oppHoldX = oppBoardX - 90;
-        drawQueue(painter, oppHoldX, boardY, "HOLD", {opponentHold}, true);
+        if (dirty.intersects(layout.oppHold)) drawQueue(painter, layout.oppHold.x(), boardY, "HOLD", {opponentHold}, true);
 
-        int oppNextX = oppBoardX + BOARD_PIXEL_W + 10;
-        drawQueue(painter, oppNextX, boardY, "NEXT", opponentNextPieces.toList(), true);
+        if (dirty.intersects(layout.oppNext)) drawQueue(painter, layout.oppNext.x(), boardY, "NEXT", opponentNextPieces.toList(), true);
     }
 
     if (isPaused) {
         painter.fillRect(rect(), QColor(0, 0, 0, 180));
         painter.setPen(Qt::white);
-        QFont f = painter.font(); f.setPointSize(40); painter.setFont(f);
+        painter.setFont(pauseFont);
         painter.drawText(rect(), Qt::AlignCenter, "PAUSED");
     }
+
+    // HUD 本身不算進繪圖時間；有畫到自己的盤面，等著的按鍵就算出現在畫面上了
+    qint64 paintEnd = profiler.now();
+    profiler.recordPaint(paintStart, paintEnd);
+    if (!keysAwaitingPaint.isEmpty() && dirty.intersects(layout.myBoard)) {
+        for (qint64 pressed : keysAwaitingPaint) profiler.recordKeyToPixel(paintEnd - pressed);
+        keysAwaitingPaint.clear();
+    }
+    if (showHud && dirty.intersects(layout.hud)) drawHud(painter, layout.hud);
+}
+
+void MainWindow::drawHud(QPainter &painter, const QRect &area)
+{
+    auto line = [](const char *label, const FrameProfiler::Summary &s) {
+        return QString("%1 p50 %2  p95 %3  p99 %4 ms")
+            .arg(label).arg(s.p50Ms, 5, 'f', 1).arg(s.p95Ms, 5, 'f', 1).arg(s.p99Ms, 5, 'f', 1);
+    };
+    FrameProfiler::Summary paint = profiler.paintTime();
+    FrameProfiler::Summary interval = profiler.frameInterval();
+    FrameProfiler::Summary keys = profiler.keyToPixel();
+
+    QStringList lines;
+    lines << line("paint ", paint);
+    lines << line("frame ", interval);
+    lines << line("key>px", keys) + QString(" (%1)").arg(keys.count);
+    if (serverClock.sampleCount() > 0) {
+        lines << QString("RTT   %1 ms  jit %2  1-way %3")
+            .arg(serverClock.rtt() / 1000.0, 5, 'f', 1).arg(serverClock.jitter() / 1000.0, 4, 'f', 1)
+            .arg(serverClock.oneWayDelay() / 1000.0, 4, 'f', 1);
+    } else {
+        lines << QString("RTT    --");
+    }
+    lines << QString("send  %1  merged %2  deferred %3").arg(framesSent).arg(framesCoalesced).arg(framesDeferred);
+    QString latency = inputLatencyCount > 0
+        ? QString("input %1 avg  %2 max ticks").arg(double(inputLatencyTotal) / inputLatencyCount, 0, 'f', 1).arg(inputLatencyMax)
+        : QString("input  --");
+    if (isAuthoritative) latency += QString("  fix %1").arg(corrections);
+    lines << latency;
+    if (profiler.isTracing()) lines << QString("F4 trace: recording (%1 events)").arg(profiler.traceEventCount());
+    else lines << (traceStatus.isEmpty() ? QString("F4 trace: off") : traceStatus);
+
+    painter.fillRect(area, QColor(0, 0, 0, 170));
+    painter.setPen(QColor(120, 255, 120));
+    painter.setFont(hudFont);
+    painter.drawText(area.adjusted(6, 4, -4, -4), Qt::AlignLeft | Qt::AlignTop, lines.join("\n"));
+}
+
+// F4：第一次按開始記錄，再按一次存成 AppData/traces/ 底下的 Chrome trace JSON
+void MainWindow::toggleTrace()
+{
+    if (!profiler.isTracing()) {
+        profiler.startTrace();
+        traceStatus.clear();
+    } else {
+        profiler.stopTrace();
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/traces";
+        QDir().mkpath(dir);
+        QString name = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+        if (profiler.writeTrace(dir + "/" + name)) {
+            traceStatus = QString("F4 saved traces/%1").arg(name);
+        } else {
+            traceStatus = QString("F4 save failed: %1").arg(name);
+        }
+    }
+    // 錄製狀態跟存檔結果都顯示在 HUD，按 F4 時順便打開
+    showHud = true;
+    update(screenLayout().hud);
 }
 
 void MainWindow::drawQueue(QPainter &painter, int x, int y, QString label, QList<int> shapes, bool isActive)
 {
     painter.setPen(Qt::white);
-    QFont f = painter.font(); f.setPointSize(10); f.setBold(true); painter.setFont(f);
+    painter.setFont(queueFont);
     painter.drawText(x, y + 20, label);
 
     int boxH = (label == "HOLD") ? 80 : 250;
@@ -675,25 +1536,66 @@ void MainWindow::drawQueue(QPainter &painter, int x, int y, QString label, QList
 
     int count = (label == "HOLD") ? 1 : qMin(shapes.size(), 3);
 
+    QPainter::PixmapFragment fragments[3 * 4];
+    int fragmentCount = 0;
     for(int i=0; i<count; i++) {
         int shape = shapes[i];
-        if (shape == 0) continue;
+        if (shape < 1 || shape > 7) continue;
 
-        QVector<QPoint> coords = getShapeCoords(shape, 0);
-        QColor c = getShapeColor(shape);
         int offsetX = 10;
         if (shape == 1) offsetX = 0;
         if (shape == 5) offsetX = 15;
 
-        for(const QPoint &p : coords) {
-            int px = x + offsetX + p.x() * 20;
-            int py = y + 50 + i*70 + p.y() * 20;
-            painter.fillRect(px, py, 20, 20, c);
-            painter.setPen(Qt::black);
-            painter.setBrush(Qt::NoBrush);
-            painter.drawRect(px, py, 20, 20);
+        for(const auto &cell : SHAPE_CELLS[shape][0]) {
+            int px = x + offsetX + cell[0] * QUEUE_CELL_SIZE;
+            int py = y + 50 + i*70 + cell[1] * QUEUE_CELL_SIZE;
+            fragments[fragmentCount++] = tileFragment(TILE_SMALL + shape, px, py);
         }
     }
+    painter.drawPixmapFragments(fragments, fragmentCount, tileAtlas);
+}
+
+void MainWindow::buildTileAtlas()
+{
+    // 每個 tile 比格子大 1 px (外框的線)，相鄰的格子外框會疊在一起，跟直接畫的結果一樣
+    const int big = CELL_SIZE + 1;
+    const int small = QUEUE_CELL_SIZE + 1;
+    qreal ratio = devicePixelRatioF();
+    tileAtlas = QPixmap(QSize(big * (TILE_GHOST + 1), big + small) * ratio);
+    tileAtlas.setDevicePixelRatio(ratio);
+    tileAtlas.fill(Qt::transparent);
+
+    QPainter painter(&tileAtlas);
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(QColor(40, 40, 40));
+    painter.drawRect(TILE_EMPTY * big, 0, CELL_SIZE, CELL_SIZE);
+
+    for (int color = 1; color <= GARBAGE_COLOR; ++color) {
+        painter.fillRect(color * big, 0, CELL_SIZE, CELL_SIZE, getShapeColor(color));
+        painter.fillRect(color * small, big, QUEUE_CELL_SIZE, QUEUE_CELL_SIZE, getShapeColor(color));
+        painter.setPen(Qt::black);
+        painter.drawRect(color * big, 0, CELL_SIZE, CELL_SIZE);
+        painter.drawRect(color * small, big, QUEUE_CELL_SIZE, QUEUE_CELL_SIZE);
+    }
+
+    painter.fillRect(TILE_GHOST * big, 0, CELL_SIZE, CELL_SIZE, QColor(255, 255, 255, 40));
+
+    // 貼圖換了，快取的盤面也要重畫
+    myBoardLayer.valid = false;
+    opponentBoardLayer.valid = false;
+}
+
+// (x, y) 是 tile 左上角的邏輯座標；來源範圍是實際像素，所以要再縮回 devicePixelRatio
+QPainter::PixmapFragment MainWindow::tileFragment(int tile, int x, int y) const
+{
+    bool isSmall = tile >= TILE_SMALL;
+    int size = isSmall ? QUEUE_CELL_SIZE + 1 : CELL_SIZE + 1;
+    int sourceX = (isSmall ? tile - TILE_SMALL : tile) * size;
+    int sourceY = isSmall ? CELL_SIZE + 1 : 0;
+    qreal ratio = tileAtlas.devicePixelRatio();
+    return QPainter::PixmapFragment::create(QPointF(x + size / 2.0, y + size / 2.0),
+                                            QRectF(sourceX * ratio, sourceY * ratio, size * ratio, size * ratio),
+                                            1 / ratio, 1 / ratio);
 }
 
 void MainWindow::drawInstructions(QPainter &painter)
@@ -701,63 +1603,83 @@ void MainWindow::drawInstructions(QPainter &painter)
     Q_UNUSED(painter);
 }
 
-void MainWindow::drawBoard(QPainter &painter, int x, int y, const QVector<int> &targetBoard, bool isPlayer)
+void MainWindow::renderBoardLayer(BoardLayer &layer, const TetrisBoard &targetBoard)
 {
+    // 外框的線寬會多出 1 px；依螢幕縮放建圖，高 DPI 下不會糊
+    qreal ratio = devicePixelRatioF();
+    layer.pixmap = QPixmap(QSize(BOARD_PIXEL_W + 1, BOARD_PIXEL_H + 1) * ratio);
+    layer.pixmap.setDevicePixelRatio(ratio);
+    layer.pixmap.fill(Qt::transparent);
+
+    QPainter painter(&layer.pixmap);
     painter.setPen(QColor(60, 60, 60));
     painter.setBrush(Qt::black);
-    painter.drawRect(x, y, BOARD_PIXEL_W, BOARD_PIXEL_H);
-
-    if (targetBoard.size() != GAME_COLS * GAME_ROWS) return;
+    painter.drawRect(0, 0, BOARD_PIXEL_W, BOARD_PIXEL_H);
 
+    QPainter::PixmapFragment fragments[GAME_ROWS * GAME_COLS];
+    int count = 0;
     for (int r = 0; r < GAME_ROWS; ++r) {
         for (int c = 0; c < GAME_COLS; ++c) {
-            int idx = r * GAME_COLS + c;
-            if (idx < 0 || idx >= targetBoard.size()) continue;
-
-            int shapeId = targetBoard[idx];
-            if (shapeId > 0) {
-                QColor color = getShapeColor(shapeId);
-                int px = x + c * CELL_SIZE;
-                int py = y + r * CELL_SIZE;
-                painter.fillRect(px, py, CELL_SIZE, CELL_SIZE, color);
-                painter.setPen(Qt::black);
-                painter.setBrush(Qt::NoBrush);
-                painter.drawRect(px, py, CELL_SIZE, CELL_SIZE);
-            } else {
-                painter.setPen(QColor(40, 40, 40));
-                painter.setBrush(Qt::NoBrush);
-                painter.drawRect(x + c * CELL_SIZE, y + r * CELL_SIZE, CELL_SIZE, CELL_SIZE);
-            }
+            int color = targetBoard.cell(c, r);
+            fragments[count++] = tileFragment(color > 0 && color <= GARBAGE_COLOR ? color : TILE_EMPTY, c * CELL_SIZE, r * CELL_SIZE);
         }
     }
+    painter.drawPixmapFragments(fragments, count, tileAtlas);
+}
 
-    if (isPlayer && !isPaused && !isGameOver) {
-        int ghostY = currentY;
-        while (tryMove(currentX, ghostY + 1, currentRotation)) ghostY++;
-
-        QVector<QPoint> coords = getShapeCoords(currentShape, currentRotation);
-
-        painter.setBrush(QColor(255, 255, 255, 40));
-        painter.setPen(Qt::NoPen);
-        for (const QPoint &p : coords) {
-            int gx = currentX + p.x();
-            int gy = ghostY + p.y();
-            if (gy >= 0) painter.drawRect(x + gx * CELL_SIZE, y + gy * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+void MainWindow::drawBoard(QPainter &painter, int x, int y, const TetrisBoard &targetBoard, bool isPlayer)
+{
+    BoardLayer &layer = isPlayer ? myBoardLayer : opponentBoardLayer;
+    quint32 revision = isPlayer ? engine.revision() : opponentRevision;
+    if (!layer.valid || layer.revision != revision || layer.pixmap.devicePixelRatio() != devicePixelRatioF()) {
+        renderBoardLayer(layer, targetBoard);
+        layer.revision = revision;
+        layer.valid = true;
+    }
+    painter.drawPixmap(x, y, layer.pixmap);
+
+    // ghost 先貼、落下中的方塊後貼，一次送出
+    QPainter::PixmapFragment fragments[8];
+    int count = 0;
+    if (!isPlayer) {
+        if (opponentFalling.shape <= 0) return;
+        for (const auto &cell : SHAPE_CELLS[opponentFalling.shape][opponentFalling.rotation]) {
+            int cx = opponentFalling.x + cell[0];
+            int cy = opponentFalling.y + cell[1];
+            if (cx >= 0 && cx < GAME_COLS && cy >= 0 && cy < GAME_ROWS) fragments[count++] = tileFragment(opponentFalling.shape, x + cx * CELL_SIZE, y + cy * CELL_SIZE);
         }
-
-        QColor curColor = getShapeColor(currentShape);
-        painter.setBrush(curColor);
-        painter.setPen(Qt::black);
-        for (const QPoint &p : coords) {
-            int cx = currentX + p.x();
-            int cy = currentY + p.y();
-            if (cy >= 0) painter.drawRect(x + cx * CELL_SIZE, y + cy * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+    } else if (!isPaused && !isGameOver) {
+        const TetrisPiece &piece = engine.piece();
+        int ghostY = engine.ghostY();
+        const auto &cells = SHAPE_CELLS[piece.shape][piece.rotation];
+
+        for (const auto &cell : cells) {
+            int gx = piece.x + cell[0];
+            int gy = ghostY + cell[1];
+            if (gy >= 0) fragments[count++] = tileFragment(TILE_GHOST, x + gx * CELL_SIZE, y + gy * CELL_SIZE);
+        }
+        // 落下中的方塊依重力進度內插，ghost 不動
+        for (const auto &cell : cells) {
+            int cx = piece.x + cell[0];
+            int cy = piece.y + cell[1];
+            if (cy >= 0) fragments[count++] = tileFragment(piece.shape, x + cx * CELL_SIZE, y + cy * CELL_SIZE + fallOffset);
         }
     }
+    painter.drawPixmapFragments(fragments, count, tileAtlas);
 }
 
 void MainWindow::keyPressEvent(QKeyEvent *event)
 {
+    if (event->key() == Qt::Key_F3) {
+        showHud = !showHud;
+        update(screenLayout().hud);
+        return;
+    }
+    if (event->key() == Qt::Key_F4) {
+        toggleTrace();
+        return;
+    }
+
     if (event->key() == Qt::Key_Escape) {
         if (isGameMode && !isOnlineMode && !isGameOver) {
             isPaused = !isPaused;
@@ -765,7 +1687,10 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
                 timer->stop();
                 bgmPlayer->pause(); // 暫停音樂
             } else {
-                timer->start(dropSpeed);
+                // 暫停的時間不算，從目前的 tick 接著跑
+                tickBase = ticker.frame();
+                gameClock.restart();
+                timer->start();
                 bgmPlayer->play();
             }
             update(); return;
@@ -778,39 +1703,54 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
 
     switch (event->key()) {
     case Qt::Key_Left:
-        if (tryMove(currentX - 1, currentY, currentRotation)) { currentX--; update(); if(isOnlineMode) sendGameState(); }
+    case Qt::Key_Right:
+    case Qt::Key_Down:
+    case Qt::Key_Up:
+    case Qt::Key_Space:
+    case Qt::Key_C:
+        pendingKeys.append(PendingKey{event->key(), wallTick(), profiler.now()});
+        gameLoop(); // 已經到期的 tick 馬上跑，不用等下一次計時器
+        break;
+    }
+}
+
+// 在 tick 開頭套用一個按鍵；移動成功時通知 ticker 重新計算鎖定延遲
+void MainWindow::applyKey(int key)
+{
+    switch (key) {
+    case Qt::Key_Left:
+        recordInput(INPUT_LEFT);
+        if (engine.moveLeft()) { ticker.pieceMoved(engine); updateMyPiece(); if(isOnlineMode) queueGameState(); }
         break;
     case Qt::Key_Right:
-        if (tryMove(currentX + 1, currentY, currentRotation)) { currentX++; update(); if(isOnlineMode) sendGameState(); }
+        recordInput(INPUT_RIGHT);
+        if (engine.moveRight()) { ticker.pieceMoved(engine); updateMyPiece(); if(isOnlineMode) queueGameState(); }
         break;
     case Qt::Key_Down:
-        if (tryMove(currentX, currentY + 1, currentRotation)) { currentY++; update(); if(isOnlineMode) sendGameState(); }
+        recordInput(INPUT_SOFT_DROP);
+        if (engine.moveDown()) { ticker.pieceMoved(engine); updateMyPiece(); if(isOnlineMode) queueGameState(); }
         break;
     case Qt::Key_Up:
-        rotateWithWallKick();
+        recordInput(INPUT_ROTATE);
+        if (engine.rotate()) { ticker.pieceMoved(engine); updateMyPiece(); if(isOnlineMode) queueGameState(); }
         break;
     case Qt::Key_Space:
-        while(tryMove(currentX, currentY + 1, currentRotation)) { currentY++; }
+        recordInput(INPUT_HARD_DROP);
         placePiece();
-        update();
         break;
     case Qt::Key_C:
-        holdPiece();
+        recordInput(INPUT_HOLD);
+        if (engine.hold()) {
+            if (engine.isGameOver()) { handleGameOver(); return; }
+            ticker.pieceSpawned(engine);
+            updateMyPiece();
+            updateMyPanels();
+            if(isOnlineMode) queueGameState();
+        }
         break;
     }
 }
 
-void MainWindow::refillBag() {
-    for (int i = 1; i <= 7; ++i) bag.append(i);
-    auto rd = std::default_random_engine { static_cast<long unsigned int>(time(0)) };
-    std::shuffle(bag.begin(), bag.end(), rd);
-}
-
-int MainWindow::getNextPieceFromBag() {
-    if (bag.isEmpty()) refillBag();
-    return bag.takeFirst();
-}
-
 QColor MainWindow::getShapeColor(int shapeId)
 {
     switch(shapeId) {
@@ -825,24 +1765,3 @@ QColor MainWindow::getShapeColor(int shapeId)
     default: return Qt::black;
     }
 }
-
-QVector<QPoint> MainWindow::getShapeCoords(int shape, int rotation) {
-    if (shape < 1 || shape > 7) return {};
-
-    static const int shapes[8][4][4][2] = {
-        { { {0,0}, {0,0}, {0,0}, {0,0} }, { {0,0}, {0,0}, {0,0}, {0,0} }, { {0,0}, {0,0}, {0,0}, {0,0} }, { {0,0}, {0,0}, {0,0}, {0,0} } },
-        { { {0,1}, {1,1}, {2,1}, {3,1} }, { {2,0}, {2,1}, {2,2}, {2,3} }, { {0,2}, {1,2}, {2,2}, {3,2} }, { {1,0}, {1,1}, {1,2}, {1,3} } },
-        { { {0,0}, {0,1}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {1,2} }, { {0,1}, {1,1}, {2,1}, {2,2} }, { {1,0}, {1,1}, {0,2}, {1,2} } },
-        { { {2,0}, {0,1}, {1,1}, {2,1} }, { {1,0}, {1,1}, {1,2}, {2,2} }, { {0,1}, {1,1}, {2,1}, {0,2} }, { {0,0}, {1,0}, {1,1}, {1,2} } },
-        { { {1,0}, {2,0}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {2,1} }, { {1,0}, {2,0}, {1,1}, {2,1} } },
-        { { {1,0}, {2,0}, {0,1}, {1,1} }, { {1,0}, {1,1}, {2,1}, {2,2} }, { {1,1}, {2,1}, {0,2}, {1,2} }, { {0,0}, {0,1}, {1,1}, {1,2} } },
-        { { {1,0}, {0,1}, {1,1}, {2,1} }, { {1,0}, {1,1}, {2,1}, {1,2} }, { {0,1}, {1,1}, {2,1}, {1,2} }, { {1,0}, {0,1}, {1,1}, {1,2} } },
-        { { {0,0}, {1,0}, {1,1}, {2,1} }, { {2,0}, {1,1}, {2,1}, {1,2} }, { {0,1}, {1,1}, {1,2}, {2,2} }, { {1,0}, {0,1}, {1,1}, {0,2} } }
-    };
-
-    QVector<QPoint> coords;
-    for(int i=0; i<4; i++) {
-        coords.append(QPoint(shapes[shape][rotation][i][0], shapes[shape][rotation][i][1]));
-    }
-    return coords;
-}
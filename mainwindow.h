@@ -3,6 +3,7 @@
 
 #include <QMainWindow>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QTcpSocket>
 #include <QVector>
 #include <QList>
@@ -12,6 +13,24 @@
 #include <QLabel>
 #include <QVBoxLayout>
 #include <QLineEdit>
+#include <QComboBox>
+#include <QThread>
+#include <QJsonObject>
+#include <QPixmap>
+#include <QPainter>
+#include <QFont>
+#include <QRect>
+
+#include "tetrisengine.h"
+#include "tetrisbot.h"
+#include "botworker.h"
+#include "framedecoder.h"
+#include "replay.h"
+#include "ticker.h"
+#include "frameprofiler.h"
+#include "clocksync.h"
+
+namespace Protocol { struct GameState; struct Sync; }
 
 // [新增] 音樂與音效標頭檔
 #include <QMediaPlayer>
@@ -36,7 +55,10 @@ private slots:
     void onBackClicked();
 
     void gameLoop();
-    void pieceDropped();
+    void flushGameState();
+    void sendPing();
+    void cpuStep();
+    void onCpuPlanReady(int requestId, const BotPlan &plan);
 
     void onSocketConnected();
     void onSocketReadyRead();
@@ -47,32 +69,93 @@ private:
     QWidget *menuWidget;
     QLabel *titleLabel;
     QLineEdit *nameInput;
+    QComboBox *difficultyBox;
     QPushButton *btnLocal;
     QPushButton *btnOnline;
     QPushButton *btnBack;
 
     void startGame();
-    void spawnPiece();
-    void holdPiece();
-    void rotateWithWallKick();
-    bool tryMove(int newX, int newY, int newRot);
     void placePiece();
-    void clearLines();
+    void finishLock(const LockResult &result);
+    void simulateTick();
+    void applyKey(int key);
+    qint64 wallTick() const;
+    void handleGameOver();
     void addGarbageLines(int count);
-    void updateGameLevel();
 
-    void refillBag();
-    int getNextPieceFromBag();
+    // 靜態盤面 (外框 + 格線 + 已鎖定的方塊) 畫一次存起來，revision 變了才重畫；
+    // 每一幀只在上面疊 ghost 與落下中的方塊，畫圖成本不會隨盤面變滿而增加
+    struct BoardLayer {
+        QPixmap pixmap;
+        quint32 revision;
+        bool valid;
+    };
+
+    // 畫面排版 (paintEvent 跟局部重畫共用同一份座標)
+    struct ScreenLayout {
+        QRect myTitle, myBoard, myHold, myNext, myStats;
+        QRect oppTitle, oppBoard, oppHold, oppNext;    // 單人時是空的
+        QRect hud;
+    };
+    ScreenLayout screenLayout() const;
+    QRect pieceArea(const TetrisPiece &piece, int bottomY, const QRect &board) const;
+
+    // 局部重畫：只把有變的區塊標成要重畫，不用每次整個視窗 update()
+    void updateMyPiece();
+    void updateMyBoard();
+    void updateMyPanels();
+    void updateOpponentPiece();
+    void updateOpponentBoard();
+    void updateOpponentPanels();
+
+    void drawHud(QPainter &painter, const QRect &area);
+    void toggleTrace();
+
+    // 預先畫好的方塊貼圖：30px 盤面格 (0 = 空格, 1~8 = 顏色, 9 = ghost) 與 20px 的 HOLD/NEXT 格，
+    // 每一幀只用 drawPixmapFragments 一次貼完；要換皮膚只改 buildTileAtlas
+    enum Tile { TILE_EMPTY = 0, TILE_GHOST = 9, TILE_SMALL = 10 };    // 小格 = TILE_SMALL + 顏色
+    void buildTileAtlas();
+    QPainter::PixmapFragment tileFragment(int tile, int x, int y) const;
 
     QColor getShapeColor(int shapeId);
-    QVector<QPoint> getShapeCoords(int shape, int rotation);
-    void drawBoard(QPainter &painter, int x, int y, const QVector<int> &targetBoard, bool isPlayer);
+    void renderBoardLayer(BoardLayer &layer, const TetrisBoard &targetBoard);
+    void drawBoard(QPainter &painter, int x, int y, const TetrisBoard &targetBoard, bool isPlayer);
     void drawInstructions(QPainter &painter);
     void drawQueue(QPainter &painter, int x, int y, QString label, QList<int> shapes, bool isActive);
 
+    void handleJsonMessage(const QJsonObject &root);
+    void handleBinaryFrame(int type, const uint8_t *data, int size);
+    void applyOpponentState(const Protocol::GameState &state);
+    void onOpponentGameOver();
+    void refreshCpuView();
+    void cpuTick();
+    void finishCpuLock(const LockResult &result);
+    void requestCpuPlan();
+    void resetCpuPlan();
+    void dropCpuPiece();
+    void onServerDeclaredLoss();
+    void applySync(const Protocol::Sync &sync);
+    bool advanceServerState(uint16_t ackInput);
+    bool reconcile();
+
+    void queueGameState();
     void sendGameState();
+    void sendStateDelta();
+    void sendKeyframe();
+    void sendPlacement(const LockResult &result);
+    void writeFrame(const uint8_t *frame, int size);
+    void writeLine(const QJsonObject &root);
+    void checkSendLimit();
+    bool acceptOpponentSeq(uint16_t seq);
+    void refreshOpponentBoard(bool lockedChanged);
     void sendAttack(int lines);
+    void sendGameOver();
     void sendPlayerName();
+    void recordInput(TetrisInput input);
+    void sendInputs();
+    void openReplay();
+    void closeReplay();
+    uint32_t replayFrame() const;
 
     // --- 變數 ---
     bool isGameMode;
@@ -80,31 +163,121 @@ private:
     bool isPaused;
     bool isGameOver;
     bool isWaitingForOpponent;
+    bool isCpuMode;         // Local 模式：對手是電腦
 
-    int score;
-    int level;
-    int dropSpeed;
+    // 固定步長 (60 tick/s)：計時器只負責照真實時間補跑 tick，重力與鎖定延遲在 ticker 裡算。
+    // 按鍵先排隊，下一個 tick 開頭才套用，延遲用 tick 數統計
+    struct PendingKey {
+        int key;
+        qint64 tick;        // 按下時的真實時間 (換算成 tick)
+        qint64 pressedNs;   // 按下時 profiler 的時間，算按鍵到畫面的延遲
+    };
+    TetrisTicker ticker;
+    QElapsedTimer gameClock;
+    qint64 tickBase;        // 暫停或卡頓丟掉的時間從這裡扣
+    QVector<PendingKey> pendingKeys;
+    int fallOffset;         // 目前畫出來的內插位移 (px)
+    quint64 inputLatencyTotal;
+    quint64 inputLatencyCount;
+    qint64 inputLatencyMax;
 
-    QVector<int> board;
-    QList<int> bag;
-    QList<int> nextPieces;
-    int currentShape;
-    int currentRotation;
-    int currentX;
-    int currentY;
+    // 效能 HUD (F3) 與 Chrome trace (F4)
+    FrameProfiler profiler;
+    bool showHud;
+    qint64 lastHudNs;                   // HUD 上次重畫的時間，數字每秒更新幾次就好
+    QString traceStatus;                // F4 上一次存檔的結果，停止錄製後顯示在 HUD
+    QVector<qint64> keysAwaitingPaint;  // 已經改變盤面、還沒畫出來的按鍵 (按下的時間)
 
-    int heldShape;
-    bool canHold;
+    // 遊戲規則全部交給 engine，MainWindow 只負責輸入、計時、繪圖與網路
+    TetrisEngine engine;
 
     QString localPlayerName;
     QString opponentName;
 
-    QVector<int> opponentBoard;
+    TetrisBoard opponentBoard;      // 顯示用的已鎖定盤面 (v1 的完整狀態會連落下中的方塊一起)
+    TetrisPiece opponentFalling;    // 對手落下中的方塊，疊在快取上面畫
+    quint32 opponentRevision;       // opponentBoard 有變就 +1
+    quint32 cpuViewRevision;        // 上次複製 cpuEngine 盤面時的 revision
+    BoardLayer myBoardLayer;
+    BoardLayer opponentBoardLayer;
+    QPixmap tileAtlas;
+    QFont titleFont;        // 繪圖用的字型開局前建好，paintEvent 裡不再每次建
+    QFont statFont;
+    QFont queueFont;
+    QFont messageFont;
+    QFont pauseFont;
+    QFont hudFont;
+    QRect lastMyPieceArea;          // 上次標成要重畫的方塊 + ghost 範圍 (移動時舊位置也要擦掉)
+    QRect lastOppPieceArea;
     int opponentHold;
     QVector<int> opponentNextPieces;
 
+    // v2 差異同步：接收端用 keyframe + 差異重建對手盤面
+    TetrisBoard opponentLocked;
+    TetrisPiece opponentPiece;
+    uint16_t opponentSeq;
+    bool opponentSynced;
+    bool keyframeRequested;
+
+    // v2 差異同步：傳送端記住上次送出的內容，只送有變的部分
+    uint16_t sendSeq;
+    int updatesSinceKeyframe;
+    bool keyframePending;
+    TetrisPiece lastSentPiece;
+    int lastSentHold;
+    int lastSentNext[NEXT_QUEUE_SIZE];
+
+    // 送出合併：每個 tick 最多送一次狀態，attack / game_over 不受影響
+    bool stateDirty;
+    int sendIntervalMs;
+    QElapsedTimer lastStateSend;
+    quint64 framesSent;
+    quint64 framesCoalesced;
+    // 流量控制：Server 讀不動時狀態先不送 (變化會併進下一次)，太多沒送出去就斷線
+    qint64 sendDisconnectBytes;
+    quint64 framesDeferred;
+
+    // 權威模式 (v3)：只送輸入，規則由 Server 跑，本地照樣先算 (預測)，收到 SYNC 再校正
+    bool isAuthoritative;
+    uint16_t inputSeq;              // 下一個輸入的序號
+    uint16_t pendingFirstInput;     // pendingInputs[0] 的序號
+    QVector<uint8_t> pendingInputs; // 還沒送出的輸入，跟狀態一樣每個 tick 合併送一次
+    int corrections;
+    // 校正的基準：serverEngine 是 Server 處理完 serverAck 號輸入時的狀態 (本地用同一串輸入推進)，
+    // unackedInputs 是之後的輸入。收到 SYNC / 垃圾行先改基準，再把 unackedInputs 重跑一次得到新的預測
+    TetrisEngine serverEngine;
+    uint16_t serverAck;
+    QVector<uint8_t> unackedInputs;
+
+    quint32 matchSeed;      // 這場的種子 (線上由 Server 給)，決定方塊順序與垃圾行的洞
+
+    // 每場都錄成重播檔 (種子 + 輸入 + 垃圾行)，frame 就是開局後的 tick
+    Replay::Writer replay;
+
+    int wireVersion;        // 0 = JSON 行, >= 1 = 二進位封包 (開局時由 Server 決定)
+    bool serverPings;       // Server 是 v4 以上：每秒 PING 一次量來回時間
+    ClockSync serverClock;  // 單位微秒，自己這邊的時鐘是 profiler.now()
+    FrameDecoder decoder;   // 收訊息用的 ring buffer
+
     QTimer *timer;
-    QTimer *lockTimer;
+    QTimer *sendTimer;
+    QTimer *pingTimer;
+    QTimer *cpuTimer;
+
+    // 電腦對手：自己一個 engine，Bot 算好落點後一個一個輸入慢慢做，看起來像真人在操作；
+    // 重力與鎖定延遲用自己的 ticker，規則跟玩家完全一樣
+    TetrisEngine cpuEngine;
+    TetrisTicker cpuTicker;
+    TetrisBot bot;
+    BotPlan cpuPlan;
+    int cpuPlanPos;
+    int cpuDifficulty;      // CPU_LEVELS 的 index
+
+    // 困難以上用 beam search，丟到背景執行緒算；requestId 對不上的結果 (盤面已經變了) 直接丟掉
+    QThread *botThread;
+    BotWorker *botWorker;
+    int cpuRequestId;
+    bool cpuThinking;
     QTcpSocket *socket;
 
     // [新增] 音樂與音效物件